@@ -0,0 +1,130 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE // For madvise (generator_hibernate) and MAP_* with -std=c11
+#endif
+#include "generator.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Holds many suspended "session" generators, hibernates them all and wakes
+// them again, reporting the resident memory per generator in each state and
+// the cost of generator_hibernate and of the first resume after it.
+// Build with GENERATOR_MMAP_STACK so that whole stacks can be released.
+// Usage: ./bench_hibernate [count]   (default 10000)
+
+typedef struct {
+    int64_t id;
+    int32_t depth;
+    char scratch[96]; // Parser-style per-frame state, mostly zeros
+} frame_t;
+
+// Recurses a few levels, like a request handler deep in its call stack,
+// and waits there for input
+static int64_t session_step(generator_t* self, frame_t* parent, int32_t depth)
+{
+    frame_t frame = { parent->id, depth, { 0 } };
+    frame.scratch[depth] = (char)depth;
+    if (depth < 8) {
+        return session_step(self, &frame, depth + 1) + frame.scratch[depth];
+    }
+    int64_t total = 0;
+    while (!generator_is_closing(self)) {
+        total += yield(self, frame.id + total);
+        ++total;
+    }
+    return total;
+}
+
+void session_generator_func(generator_t* self)
+{
+    frame_t root = { (int64_t)(intptr_t)self->user_data, 0, { 0 } };
+    session_step(self, &root, 1);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static size_t resident_bytes(void)
+{
+    size_t pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static int64_t resume_all(generator_t** gens, size_t count, double* elapsed)
+{
+    bool finished = false;
+    int64_t sum = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        sum += generator_next(gens[i], &finished);
+    }
+    *elapsed = now_ns() - start;
+    return sum;
+}
+
+int32_t main(int32_t argc, char** argv)
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+    generator_t** gens = malloc(count * sizeof(generator_t*));
+    if (!gens) {
+        return 1;
+    }
+
+    size_t rss_start = resident_bytes();
+    for (size_t i = 0; i < count; ++i) {
+        gens[i] = generator_create(session_generator_func, (void*)(intptr_t)i, 64 * 1024);
+        if (!gens[i]) {
+            fprintf(stderr, "Failed to create generator %zu.\n", i);
+            return 1;
+        }
+        bool finished = false;
+        generator_next(gens[i], &finished); // Leave it suspended deep in yield
+    }
+    double warm_ns = 0;
+    int64_t warm_sum = resume_all(gens, count, &warm_ns);
+    size_t rss_suspended = resident_bytes();
+
+    size_t image_bytes = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        image_bytes += generator_hibernate(gens[i]);
+    }
+    double hibernate_ns = now_ns() - start;
+    size_t rss_hibernated = resident_bytes();
+
+    double wake_ns = 0;
+    int64_t wake_sum = resume_all(gens, count, &wake_ns);
+    size_t rss_woken = resident_bytes();
+
+    printf("%zu suspended generators (checksums %" PRId64 " / %" PRId64 ")\n",
+        count, warm_sum, wake_sum);
+    printf("resident per generator: %.1f bytes suspended, %.1f hibernated, "
+           "%.1f woken\n",
+        (double)(rss_suspended - rss_start) / (double)count,
+        (double)(rss_hibernated - rss_start) / (double)count,
+        (double)(rss_woken - rss_start) / (double)count);
+    printf("%.1f bytes per compressed image\n", (double)image_bytes / (double)count);
+    printf("%.1f ns per generator_hibernate\n", hibernate_ns / (double)count);
+    printf("%.1f ns per resume, %.1f ns per resume after hibernation\n",
+        warm_ns / (double)count, wake_ns / (double)count);
+
+    for (size_t i = 0; i < count; ++i) {
+        generator_destroy(gens[i]);
+    }
+    free(gens);
+    return (wake_sum == warm_sum + (int64_t)count) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+#include "generator.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Holds many suspended generators at once and reports the resident memory
+// per generator and the cost of resuming them round-robin.
+// Usage: ./bench_shared_stack [count]   (default 1000000)
+
+#ifdef GENERATOR_SHARED_STACK
+#define MODE_NAME "shared stack"
+#else
+#define MODE_NAME "dedicated stacks"
+#endif
+
+// A typical small generator: a few locals, never recurses
+void ticker_generator_func(generator_t* self)
+{
+    int64_t id = (int64_t)(intptr_t)self->user_data;
+    for (int64_t tick = 0;; ++tick) {
+        yield(self, id + tick);
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static size_t resident_bytes(void)
+{
+    size_t pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+int32_t main(int32_t argc, char** argv)
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    generator_t** gens = malloc(count * sizeof(generator_t*));
+    if (!gens) {
+        return 1;
+    }
+
+    size_t rss_before = resident_bytes();
+    double start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        gens[i] = generator_create(ticker_generator_func, (void*)(intptr_t)i, 0);
+        if (!gens[i]) {
+            fprintf(stderr, "Failed to create generator %zu.\n", i);
+            return 1;
+        }
+        bool finished = false;
+        generator_next(gens[i], &finished); // Leave it suspended in yield
+    }
+    double create_ns = now_ns() - start;
+    size_t rss_after = resident_bytes();
+
+    bool finished = false;
+    int64_t sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        sum += generator_next(gens[i], &finished);
+    }
+    double resume_ns = now_ns() - start;
+
+    printf("mode: %s, %zu suspended generators (checksum %" PRId64 ")\n",
+        MODE_NAME, count, sum);
+    printf("%.1f bytes resident per suspended generator\n",
+        (double)(rss_after - rss_before) / (double)count);
+    printf("%.1f ns per create + first resume\n", create_ns / (double)count);
+    printf("%.1f ns per round-robin resume\n", resume_ns / (double)count);
+
+    for (size_t i = 0; i < count; ++i) {
+        generator_destroy(gens[i]);
+    }
+    free(gens);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include "generator.h"
+#include "generator_stackless.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Pulls ITERATIONS Fibonacci numbers (mod 2^64) from a stackless generator
+// and from a generator.h generator, and reports ns per value for each.
+
+#define ITERATIONS 10000000
+
+typedef struct {
+    uint64_t a;
+    uint64_t b;
+} fib_state_t;
+
+void fib_stackless_func(stackless_generator_t* self)
+{
+    fib_state_t* st = self->user_data;
+    STACKLESS_BEGIN(self);
+    for (;;) {
+        STACKLESS_YIELD(self, (int64_t)st->a);
+        uint64_t next_b = st->a + st->b;
+        st->a = st->b;
+        st->b = next_b;
+    }
+    STACKLESS_END(self);
+}
+
+void fib_stackful_func(generator_t* self)
+{
+    uint64_t a = 1;
+    uint64_t b = 1;
+    for (;;) {
+        yield(self, (int64_t)a);
+        uint64_t next_b = a + b;
+        a = b;
+        b = next_b;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int32_t main()
+{
+    bool finished = false;
+
+    fib_state_t state = { 1, 1 };
+    stackless_generator_t sgen;
+    stackless_generator_init(&sgen, fib_stackless_func, &state);
+    uint64_t sum_stackless = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        sum_stackless += (uint64_t)stackless_generator_next(&sgen, &finished);
+    }
+    double stackless_ns = now_ns() - start;
+
+    generator_t* gen = generator_create(fib_stackful_func, NULL, 0);
+    if (!gen) {
+        return 1;
+    }
+    uint64_t sum_stackful = 0;
+    start = now_ns();
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        sum_stackful += (uint64_t)generator_next(gen, &finished);
+    }
+    double stackful_ns = now_ns() - start;
+    generator_destroy(gen);
+
+    printf("fib, %d values (checksums %" PRIu64 " / %" PRIu64 ")\n", ITERATIONS,
+        sum_stackless, sum_stackful);
+    printf("stackless:       %.2f ns per value\n", stackless_ns / ITERATIONS);
+#ifdef GENERATOR_ASM_SWITCH
+    printf("generator.h asm: %.2f ns per value\n", stackful_ns / ITERATIONS);
+#else
+    printf("ucontext:        %.2f ns per value\n", stackful_ns / ITERATIONS);
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "generator.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Measures the cost of a generator_next/yield round trip (two context switches)
+// and, for comparison, of a value delivered by generator_for_each (no switch)
+
+#define ITERATIONS 10000000
+
+#ifdef GENERATOR_ASM_SWITCH
+#ifdef GENERATOR_ASM_NO_FPU
+#define BACKEND_NAME "asm (no fpu)"
+#else
+#define BACKEND_NAME "asm"
+#endif
+#else
+#define BACKEND_NAME "ucontext"
+#endif
+
+// Yields forever; the benchmark stops pulling after ITERATIONS values
+void counter_generator_func(generator_t* self)
+{
+    for (int64_t i = 0;; ++i) {
+        yield(self, i);
+    }
+}
+
+typedef struct {
+    int64_t sum;
+    size_t left;
+} consumer_state_t;
+
+static bool sum_consumer(int64_t value, void* ctx)
+{
+    consumer_state_t* state = ctx;
+    state->sum += value;
+    return --state->left > 0;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int32_t main()
+{
+    generator_t* gen = generator_create(counter_generator_func, NULL, 0);
+    if (!gen) {
+        return 1;
+    }
+
+    bool finished = false;
+    int64_t sum = 0;
+
+    double start = now_ns();
+    for (size_t i = 0; i < ITERATIONS && !finished; ++i) {
+        sum += generator_next(gen, &finished);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("backend: %s\n", BACKEND_NAME);
+    printf("%d round trips in %.3f ms (checksum %" PRId64 ")\n", ITERATIONS,
+        elapsed / 1e6, sum);
+    printf("%.2f ns per round trip, %.2f ns per switch\n",
+        elapsed / ITERATIONS, elapsed / ITERATIONS / 2);
+    generator_destroy(gen);
+
+    gen = generator_create(counter_generator_func, NULL, 0);
+    if (!gen) {
+        return 1;
+    }
+
+    consumer_state_t state = { 0, ITERATIONS };
+    start = now_ns();
+    generator_for_each(gen, sum_consumer, &state);
+    elapsed = now_ns() - start;
+
+    printf("push mode: %.2f ns per value (checksum %" PRId64 ")\n",
+        elapsed / ITERATIONS, state.sum);
+
+    generator_destroy(gen);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "generator.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Runs the same 4-stage pipeline (source -> +1 -> *2 -> sink) twice: once
+// with every stage pulling from the previous one through generator_next
+// (8 switches per item), and once with every stage handing the item on with
+// generator_transfer (5 switches per item).
+
+#define ITEMS 5000000
+
+typedef struct {
+    generator_t* neighbour; // Upstream stage (pull) or downstream stage (push)
+    int64_t add;
+    int64_t mul;
+} stage_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// --- Pull: each stage calls generator_next on its upstream ---
+
+void pull_source_func(generator_t* self)
+{
+    for (int64_t i = 0; i < ITEMS; ++i) {
+        yield(self, i);
+    }
+}
+
+void pull_stage_func(generator_t* self)
+{
+    stage_t* stage = (stage_t*)self->user_data;
+    bool finished = false;
+    for (;;) {
+        int64_t value = generator_next(stage->neighbour, &finished);
+        if (finished) {
+            return;
+        }
+        yield(self, (value + stage->add) * stage->mul);
+    }
+}
+
+// --- Push: each stage transfers straight to its downstream ---
+
+void push_source_func(generator_t* self)
+{
+    stage_t* stage = (stage_t*)self->user_data;
+    for (int64_t i = 0; i < ITEMS; ++i) {
+        generator_transfer(self, stage->neighbour, i);
+    }
+}
+
+void push_stage_func(generator_t* self)
+{
+    stage_t* stage = (stage_t*)self->user_data;
+    int64_t value = self->sent_value;
+    for (;;) {
+        value = generator_transfer(self, stage->neighbour,
+            (value + stage->add) * stage->mul);
+    }
+}
+
+void push_sink_func(generator_t* self)
+{
+    int64_t value = self->sent_value;
+    for (;;) {
+        value = yield(self, value); // Back to the caller of the source
+    }
+}
+
+static int64_t drain(generator_t* gen, double* elapsed)
+{
+    bool finished = false;
+    int64_t sum = 0;
+    double start = now_ns();
+    for (;;) {
+        int64_t value = generator_next(gen, &finished);
+        if (finished) {
+            break;
+        }
+        sum += value;
+    }
+    *elapsed = now_ns() - start;
+    return sum;
+}
+
+int32_t main()
+{
+    stage_t pull_stages[3] = { { NULL, 1, 1 }, { NULL, 0, 2 }, { NULL, 0, 1 } };
+    generator_t* pull[4];
+    pull[0] = generator_create(pull_source_func, NULL, 0);
+    for (int i = 1; i < 4; ++i) {
+        pull_stages[i - 1].neighbour = pull[i - 1];
+        pull[i] = generator_create(pull_stage_func, &pull_stages[i - 1], 0);
+    }
+
+    stage_t push_stages[3] = { { NULL, 0, 1 }, { NULL, 1, 1 }, { NULL, 0, 2 } };
+    generator_t* push[4];
+    push[3] = generator_create(push_sink_func, NULL, 0);
+    for (int i = 2; i >= 0; --i) {
+        push_stages[i].neighbour = push[i + 1];
+        push[i] = generator_create(i == 0 ? push_source_func : push_stage_func,
+            &push_stages[i], 0);
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        if (!pull[i] || !push[i]) {
+            return 1;
+        }
+    }
+
+    double pull_ns = 0, push_ns = 0;
+    int64_t pull_sum = drain(pull[3], &pull_ns);
+    int64_t push_sum = drain(push[0], &push_ns);
+
+    printf("%d items through 4 stages (checksums %" PRId64 " / %" PRId64 ")\n",
+        ITEMS, pull_sum, push_sum);
+    printf("pull (generator_next):      %.2f ns per item\n", pull_ns / ITEMS);
+    printf("push (generator_transfer):  %.2f ns per item\n", push_ns / ITEMS);
+
+    for (int i = 0; i < 4; ++i) {
+        generator_destroy(pull[i]);
+        generator_destroy(push[i]);
+    }
+    return (pull_sum == push_sum) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
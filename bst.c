@@ -79,6 +79,25 @@ void bst_inorder_recursive_generator(generator_t* self)
     // returns, causing the state to become GEN_FINISHED in generator_entry_point.
 }
 
+// Combine function for generator_zip: compares the next in-order value
+// with the current one. ctx points to the step counter.
+int64_t check_increasing(int64_t value_a, int64_t value_b, void* ctx)
+{
+    int32_t* step = ctx;
+    printf("Step %d: Comparing A=%" PRId64 " (next) with B=%" PRId64
+           " (current)\n",
+        *step, value_a, value_b);
+    (*step)++;
+    if (value_a <= value_b) {
+        printf("Check FAILED: %" PRId64 " <= %" PRId64
+               ". Not strictly increasing.\n",
+            value_a, value_b);
+        return false;
+    }
+    printf("Check OK: %" PRId64 " > %" PRId64 "\n", value_a, value_b);
+    return true;
+}
+
 // In the same file (bst_recursive_example.c)
 
 // Function to check the BST property using two generators
@@ -90,24 +109,20 @@ bool check_bst_property(TreeNode* root)
         return true; // Empty tree is considered valid
     }
 
-    // Create two independent generators for the same tree
-    // Use a larger stack size if deep recursion is expected
-    size_t stack_size = 32 * 1024; // 32 KB, adjust as needed
-    generator_t* gen_a = generator_create(bst_inorder_recursive_generator, root, stack_size);
-    generator_t* gen_b = generator_create(bst_inorder_recursive_generator, root, stack_size);
-
-    if (!gen_a || !gen_b) {
-        fprintf(stderr, "Failed to create generators.\n");
-        if (gen_a)
-            generator_destroy(gen_a);
-        if (gen_b)
-            generator_destroy(gen_b);
+    // Two independent generators for the same tree, living in this frame
+    // (no heap allocation). Use a larger stack if deep recursion is expected.
+    GENERATOR_STORAGE(32 * 1024) walk_a, walk_b; // 32 KB, adjust as needed
+    generator_t* gen_a = &walk_a.gen;
+    generator_t* gen_b = &walk_b.gen;
+
+    if (!generator_init(gen_a, walk_a.stack, sizeof(walk_a.stack), bst_inorder_recursive_generator, root)
+        || !generator_init(gen_b, walk_b.stack, sizeof(walk_b.stack), bst_inorder_recursive_generator, root)) {
+        fprintf(stderr, "Failed to initialize generators.\n");
         return false; // Indicate failure
     }
 
     bool finished_a = false;
-    bool finished_b = false;
-    int64_t value_a, value_b;
+    int64_t value_a;
     bool result = true; // Assume true initially
 
     // Advance gen_a once (like next(fa))
@@ -121,31 +136,26 @@ bool check_bst_property(TreeNode* root)
     }
     printf("Generator A first value: %" PRId64 "\n", value_a);
 
-    printf("Starting simultaneous iteration (like zip)...\n");
+    printf("Starting simultaneous iteration (generator_zip)...\n");
     int32_t step = 0;
-    while (true) {
-        // Get next value from gen_b (current value, like sl)
-        value_b = generator_next(gen_b, &finished_b);
-        value_a = generator_next(gen_a, &finished_a);
+    // pairs owns gen_a and gen_b from here on
+    generator_t* pairs = generator_zip(gen_a, gen_b, check_increasing, &step);
+    if (!pairs) {
+        fprintf(stderr, "Failed to zip generators.\n");
+        return false;
+    }
 
-        if (finished_b || finished_a) {
+    bool finished = false;
+    while (true) {
+        int64_t increasing = generator_next(pairs, &finished);
+        if (finished) {
             printf("One of the generators finished. All comparisons passed.\n");
             break;
         }
-
-        printf("Step %d: Comparing A=%" PRId64 " (next) with B=%" PRId64
-               " (current)\n",
-            step, value_a, value_b);
-        if (value_a <= value_b) {
-            printf("Check FAILED: %" PRId64 " <= %" PRId64
-                   ". Not strictly increasing.\n",
-                value_a, value_b);
+        if (!increasing) {
             result = false;
             break; // Property violated
-        } else {
-            printf("Check OK: %" PRId64 " > %" PRId64 "\n", value_a, value_b);
         }
-        step++;
         if (step > 100) { // Safety break for unexpected issues
             fprintf(stderr, "Error: Safety break triggered in comparison loop.\n");
             result = false;
@@ -154,8 +164,7 @@ bool check_bst_property(TreeNode* root)
     }
 
     printf("Cleaning up generators...\n");
-    generator_destroy(gen_a);
-    generator_destroy(gen_b);
+    generator_destroy(pairs);
     printf("--- Check Finished (Result: %s) ---\n", result ? "true" : "false");
     return result;
 }
@@ -46,18 +46,14 @@ void inorder_recursive_helper(generator_t* self, TreeNode* node)
     inorder_recursive_helper(self, node->left);
 
     // Check if generator was destroyed while recursing left
-    pthread_mutex_lock(&self->mtx);
     bool finished = (self->state == GEN_FINISHED);
-    pthread_mutex_unlock(&self->mtx);
     if (finished)
         return;
 
     yield(self, (int64_t)node->data);
 
     // Check if generator was destroyed while yielded or recursing left
-    pthread_mutex_lock(&self->mtx);
     finished = (self->state == GEN_FINISHED);
-    pthread_mutex_unlock(&self->mtx);
     if (finished)
         return;
 
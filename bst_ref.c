@@ -0,0 +1,137 @@
+#include "generator.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct TreeNode {
+    int32_t data;
+    struct TreeNode* left;
+    struct TreeNode* right;
+} TreeNode;
+
+// --- BST Helper Functions ---
+TreeNode* create_node(int32_t data)
+{
+    TreeNode* newNode = malloc(sizeof(TreeNode));
+    if (!newNode) {
+        perror("Failed to allocate TreeNode");
+        exit(EXIT_FAILURE);
+    }
+    newNode->data = data;
+    newNode->left = NULL;
+    newNode->right = NULL;
+    return newNode;
+}
+
+// Free the tree (post-order traversal)
+void free_tree(TreeNode* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    free_tree(node->left);
+    free_tree(node->right);
+    free(node);
+}
+
+// --- In-order walk handing out the nodes themselves ---
+// The consumer gets a TreeNode* through generator_next_ref instead of a copy
+// of the key, so it can look at the whole node (or its subtrees).
+void inorder_ref_helper(generator_t* self, TreeNode* node)
+{
+    if (node == NULL || self->state != GEN_RUNNING) {
+        return;
+    }
+    inorder_ref_helper(self, node->left);
+    if (self->state != GEN_RUNNING)
+        return;
+    yield_ref(self, node, sizeof(*node));
+    inorder_ref_helper(self, node->right);
+}
+
+void bst_inorder_ref_generator(generator_t* self)
+{
+    inorder_ref_helper(self, self->user_data);
+}
+
+// --- Root-to-leaf paths as spans of the generator's own stack ---
+// Each path is collected in a local array on the generator's stack and
+// handed out with yield_span; it is only valid until the next resume.
+void paths_helper(generator_t* self, TreeNode* node, int32_t* path, size_t depth)
+{
+    if (node == NULL || self->state != GEN_RUNNING) {
+        return;
+    }
+    path[depth++] = node->data;
+    if (!node->left && !node->right) {
+        yield_span(self, path, depth);
+        return;
+    }
+    paths_helper(self, node->left, path, depth);
+    paths_helper(self, node->right, path, depth);
+}
+
+void bst_paths_generator(generator_t* self)
+{
+    int32_t path[64]; // Deep enough for this example
+    paths_helper(self, self->user_data, path, 0);
+}
+
+int32_t main()
+{
+    printf("Building BST...\n");
+    TreeNode* root = create_node(50);
+    root->left = create_node(30);
+    root->right = create_node(70);
+    root->left->right = create_node(40);
+    root->right->left = create_node(60);
+
+    printf("In-order nodes by reference:\n");
+    generator_t* nodes = generator_create(bst_inorder_ref_generator, root, 0);
+    if (!nodes) {
+        free_tree(root);
+        return EXIT_FAILURE;
+    }
+    bool done = false;
+    int32_t previous = INT32_MIN;
+    for (;;) {
+        size_t len = 0;
+        const TreeNode* node = generator_next_ref(nodes, &len, &done);
+        if (done) {
+            break;
+        }
+        assert(len == sizeof(TreeNode));
+        assert(node->data > previous); // In-order walk of a valid BST
+        previous = node->data;
+        printf("%d (node %p, %s)\n", node->data, (const void*)node,
+            (node->left || node->right) ? "inner" : "leaf");
+    }
+    generator_destroy(nodes);
+
+    printf("Root-to-leaf paths by reference:\n");
+    generator_t* paths = generator_create(bst_paths_generator, root, 0);
+    if (!paths) {
+        free_tree(root);
+        return EXIT_FAILURE;
+    }
+    for (;;) {
+        size_t len = 0;
+        const int32_t* path = generator_next_ref(paths, &len, &done);
+        if (done) {
+            break;
+        }
+        for (size_t i = 0; i < len / sizeof(int32_t); ++i) {
+            printf("%s%d", i ? " -> " : "", path[i]);
+        }
+        printf("\n");
+    }
+    generator_destroy(paths);
+
+    free_tree(root);
+    printf("Example finished.\n");
+    return EXIT_SUCCESS;
+}
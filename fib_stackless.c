@@ -0,0 +1,63 @@
+#include "generator_stackless.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Everything that has to survive a yield lives here, not in locals
+typedef struct {
+    int64_t a;
+    int64_t b;
+    size_t i;
+} fib_state_t;
+
+// User-defined Fibonacci generator function
+// Note: It is re-entered on every next and resumes after its last yield
+void fib_generator_func(stackless_generator_t* self)
+{
+    fib_state_t* st = self->user_data;
+
+    STACKLESS_BEGIN(self);
+
+    // Generate the first 10 Fibonacci numbers
+    for (st->i = 0; st->i < 10; ++st->i) {
+        STACKLESS_YIELD(self, st->a);
+
+        // Calculate the next number
+        int64_t next_a = st->b;
+        int64_t next_b = st->a + st->b;
+        st->a = next_a;
+        st->b = next_b;
+    }
+
+    // When the body ends, the generator state will become FINISHED
+    printf("[Fib Generator] Function finished.\n");
+
+    STACKLESS_END(self);
+}
+
+int32_t main()
+{
+    printf("Creating stackless Fibonacci generator...\n");
+    fib_state_t state = { 1, 1, 0 };
+    stackless_generator_t fib_gen;
+    stackless_generator_init(&fib_gen, fib_generator_func, &state);
+
+    printf("Generating Fibonacci numbers using the stackless generator:\n");
+
+    bool finished = false;
+    size_t count = 0;
+    while (!finished && count < 15) { // Add a maximum count just in case
+        int64_t value = stackless_generator_next(&fib_gen, &finished);
+        if (!finished) {
+            printf("%" PRId64 "\n", value);
+        } else {
+            printf("Generator finished.\n");
+        }
+        count++;
+    }
+
+    printf("Finished.\n");
+    return EXIT_SUCCESS;
+}
@@ -2,15 +2,163 @@
 #define GENERATOR_H
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> // For memcpy
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE // For ucontext
 #endif
 #include <stdbool.h>
+#include <stddef.h> // For offsetof
 #include <stdint.h> // For int64_t
+
+// --- Build Options ---
+// GENERATOR_ASM_SWITCH  Use the hand-written x86-64 context switch instead of
+//                       swapcontext. It saves only the callee-saved registers,
+//                       the stack pointer and the MXCSR/x87 control words, and
+//                       makes no system calls.
+// GENERATOR_ASM_NO_FPU  With GENERATOR_ASM_SWITCH, also skip the MXCSR/x87
+//                       control words. Only safe if no generator (and no caller)
+//                       changes the floating point rounding/exception modes.
+// GENERATOR_MMAP_STACK  Reserve stacks with mmap(MAP_NORESERVE) and put a
+//                       PROT_NONE guard page below each one. Pages are only
+//                       committed when touched, so the default stack becomes
+//                       a 1MB reservation and an overflow faults cleanly
+//                       instead of corrupting the heap. Needs
+//                       _DEFAULT_SOURCE in strict ISO C mode (-std=c11).
+// GENERATOR_STACK_POOL  Recycle stacks through per-thread magazines and a
+//                       shared depot instead of allocating one per
+//                       generator_create. Generators may be destroyed on a
+//                       different thread than the one that created them.
+//                       Tune with GENERATOR_POOL_MAGAZINE_SIZE (stacks per
+//                       size class per thread) and GENERATOR_POOL_MAX_RETAINED
+//                       (bytes, see generator_pool_set_limit).
+// GENERATOR_SHARED_STACK Run every generator of a thread on one shared
+//                       execution stack of GENERATOR_SHARED_STACK_SIZE bytes.
+//                       When a different generator is resumed, the live part
+//                       of the previous one is copied to a right-sized heap
+//                       buffer and copied back on its next resume. The
+//                       stack_size argument of generator_create is ignored.
+//                       Generators must be created, resumed and destroyed on
+//                       one thread, and one shared-stack generator cannot
+//                       resume another.
+// GENERATOR_COMPACT     With GENERATOR_ASM_SWITCH (and without
+//                       GENERATOR_SHARED_STACK), place the control block in
+//                       the top 128 bytes of the generator's own stack
+//                       allocation: one allocation per generator, hot fields
+//                       in one cache line, and the stack_size passed to
+//                       generator_create covers both. Stacks are limited to
+//                       4GB.
+// GENERATOR_LAZY_STACK  Allocate the stack and build the initial context on
+//                       the first resume instead of in generator_create, so
+//                       a generator that is never resumed costs only its
+//                       control block. An allocation failure then shows up
+//                       as the generator finishing on that first resume.
+//                       Not combinable with GENERATOR_COMPACT or
+//                       GENERATOR_SHARED_STACK (which is lazy already).
+// GENERATOR_STACK_STATS Paint each generator's stack when it is set up and
+//                       measure how deep the generator went once its run is
+//                       over (generator_destroy, generator_reset). Peaks are
+//                       collected per generator function, for up to
+//                       GENERATOR_STACK_STATS_FUNCS functions process-wide;
+//                       see generator_stack_stats. Painting writes the whole
+//                       stack, so it also commits GENERATOR_MMAP_STACK
+//                       reservations. Not combinable with
+//                       GENERATOR_SHARED_STACK.
+// GENERATOR_STACK_AUTOTUNE Implies GENERATOR_STACK_STATS. Once a function has
+//                       GENERATOR_AUTOTUNE_MIN_SAMPLES measured runs,
+//                       generator_create gives its new generators the largest
+//                       peak seen plus GENERATOR_AUTOTUNE_HEADROOM percent
+//                       plus GENERATOR_AUTOTUNE_SLACK bytes (for signal
+//                       frames), capped at the requested (or default) size.
+//                       A run deeper than any measured one can overflow, so
+//                       pair it with GENERATOR_MMAP_STACK guard pages.
+// GENERATOR_FREE_LIST   Keep destroyed generators, stack included, on a
+//                       per-thread free list for their generator function;
+//                       generator_create with the same function reuses them
+//                       through generator_reset, so hot paths get warm,
+//                       already faulted-in stacks. Up to
+//                       GENERATOR_FREE_LIST_SIZE generators are kept for each
+//                       of GENERATOR_FREE_LIST_FUNCS functions per thread;
+//                       they are released when the thread exits, or earlier
+//                       with generator_free_list_flush.
+#if defined(GENERATOR_ASM_SWITCH) && !defined(__x86_64__)
+#error "GENERATOR_ASM_SWITCH is only implemented for x86-64"
+#endif
+#if defined(GENERATOR_COMPACT) && !defined(GENERATOR_ASM_SWITCH)
+#error "GENERATOR_COMPACT needs GENERATOR_ASM_SWITCH (a ucontext_t alone is ~1KB)"
+#endif
+#if defined(GENERATOR_COMPACT) && defined(GENERATOR_SHARED_STACK)
+#error "GENERATOR_COMPACT and GENERATOR_SHARED_STACK cannot be combined"
+#endif
+#if defined(GENERATOR_LAZY_STACK) && (defined(GENERATOR_COMPACT) || defined(GENERATOR_SHARED_STACK))
+#error "GENERATOR_LAZY_STACK cannot be combined with GENERATOR_COMPACT or GENERATOR_SHARED_STACK"
+#endif
+#if defined(GENERATOR_STACK_AUTOTUNE) && !defined(GENERATOR_STACK_STATS)
+#define GENERATOR_STACK_STATS
+#endif
+#if defined(GENERATOR_STACK_STATS) && defined(GENERATOR_SHARED_STACK)
+#error "GENERATOR_STACK_STATS needs dedicated stacks (not GENERATOR_SHARED_STACK)"
+#endif
+
+#ifndef GENERATOR_ASM_SWITCH
 #include <ucontext.h>
+#endif
+#include <sys/mman.h> // For mmap, madvise, mincore
+#include <unistd.h> // For sysconf
+#ifdef MADV_DONTNEED
+// madvise and mincore are not declared in strict ISO C modes (-std=c11 with
+// glibc); generator_trim and generator_hibernate need them
+#define GENERATOR_HAVE_MADVISE
+#endif
+#if defined(GENERATOR_MMAP_STACK) && !defined(MAP_ANONYMOUS)
+#error "GENERATOR_MMAP_STACK needs MAP_ANONYMOUS and MAP_NORESERVE: define _DEFAULT_SOURCE (or use -std=gnu11) in strict ISO C mode"
+#endif
+#ifdef GENERATOR_STACK_POOL
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+#ifdef GENERATOR_FREE_LIST
+#include <pthread.h>
+#endif
+#ifdef GENERATOR_STACK_STATS
+#include <stdatomic.h>
+#endif
 
 // --- Constants ---
+#ifdef GENERATOR_MMAP_STACK
+#define DEFAULT_STACK_SIZE (1024 * 1024) // Default 1MB reservation
+#else
 #define DEFAULT_STACK_SIZE (16 * 1024) // Default 16KB stack
+#endif
+#ifndef GENERATOR_SHARED_STACK_SIZE
+#define GENERATOR_SHARED_STACK_SIZE (1024 * 1024) // Per-thread execution stack
+#endif
+#ifndef GENERATOR_FREE_LIST_SIZE
+#define GENERATOR_FREE_LIST_SIZE 8 // Generators kept per function
+#endif
+#ifndef GENERATOR_FREE_LIST_FUNCS
+#define GENERATOR_FREE_LIST_FUNCS 16 // Functions tracked per thread
+#endif
+#ifndef GENERATOR_STACK_STATS_FUNCS
+#define GENERATOR_STACK_STATS_FUNCS 64 // Functions with stack statistics
+#endif
+#ifndef GENERATOR_AUTOTUNE_MIN_SAMPLES
+#define GENERATOR_AUTOTUNE_MIN_SAMPLES 8 // Runs measured before sizing
+#endif
+#ifndef GENERATOR_AUTOTUNE_HEADROOM
+#define GENERATOR_AUTOTUNE_HEADROOM 50 // Percent added to the largest peak
+#endif
+#ifndef GENERATOR_AUTOTUNE_SLACK
+#define GENERATOR_AUTOTUNE_SLACK 4096 // Bytes added for signal frames
+#endif
+#if !defined(GENERATOR_TRIM_ADVICE) && defined(GENERATOR_HAVE_MADVISE)
+#define GENERATOR_TRIM_ADVICE MADV_DONTNEED // Or MADV_FREE, see generator_trim
+#endif
+#ifndef GENERATOR_POOL_MAGAZINE_SIZE
+#define GENERATOR_POOL_MAGAZINE_SIZE 8
+#endif
+#ifndef GENERATOR_POOL_MAX_RETAINED
+#define GENERATOR_POOL_MAX_RETAINED (64 * 1024 * 1024) // 64MB of idle stacks
+#endif
 
 // --- Opaque Generator Type ---
 
@@ -25,178 +173,2403 @@ typedef void (*generator_func_t)(generator_t* self);
 
 typedef enum { GEN_RUNNING,
     GEN_SUSPENDED,
-    GEN_FINISHED } generator_state_t;
+    GEN_FINISHED,
+    GEN_HIBERNATED } generator_state_t; // Suspended, stack compressed away (generator_hibernate)
+
+// --- Combinator Types ---
+
+// Stage functions for generator_map, generator_filter, generator_enumerate
+// and generator_zip. ctx is the pointer given when the stage was attached.
+typedef int64_t (*generator_map_func_t)(int64_t value, void* ctx);
+typedef bool (*generator_filter_func_t)(int64_t value, void* ctx);
+typedef int64_t (*generator_combine_func_t)(int64_t a, int64_t b, void* ctx);
+
+// Consumer for generator_for_each: return true to continue, false to stop
+typedef bool (*generator_consume_func_t)(int64_t value, void* ctx);
+
+typedef enum { GEN_STAGE_MAP,
+    GEN_STAGE_FILTER,
+    GEN_STAGE_TAKE,
+    GEN_STAGE_ENUMERATE } generator_stage_kind_t;
+
+typedef struct {
+    generator_stage_kind_t kind;
+    union {
+        generator_map_func_t map;
+        generator_filter_func_t filter;
+        generator_combine_func_t combine;
+    } func;
+    void* ctx;
+    uint64_t count; // Take: values left; enumerate: next index
+} generator_stage_t;
+
+// Stages run in the order they were attached, inside yield()
+typedef struct {
+    size_t count;
+    size_t capacity;
+    bool exhausted; // A take stage has reached its limit
+    generator_stage_t stage[];
+} generator_stages_t;
+
+// State of a zip or chain generator, kept in its user_data
+typedef struct {
+    generator_t* inputs[2]; // Owned: destroyed with the combinator
+    size_t current; // Chain: input being drained
+    generator_combine_func_t combine; // Zip only
+    void* ctx;
+} generator_combinator_t;
 
+#ifdef GENERATOR_ASM_SWITCH
+// Everything except the stack pointer is pushed onto the stack being left
+typedef struct {
+    void* sp;
+} generator_context_t;
+#else
+typedef ucontext_t generator_context_t;
+#endif
+
+// Fields used on every resume and yield come first; with
+// GENERATOR_ASM_SWITCH the contexts, values, state and flags fill the first
+// cache line, and the delegation, pull and reference fields follow.
 struct generator {
-    ucontext_t context; // Generator's own context
-    ucontext_t caller_context; // Context of the caller of generator_next
-    void* stack; // Stack allocated for the generator
-    size_t stack_size; // Stack size
-    generator_func_t user_func; // User-provided function
+    generator_context_t context; // Generator's own context
+    generator_context_t caller_context; // Context of the caller of generator_next
+    generator_t* origin; // Generator resumed by the caller; differs after a transfer, NULL until started
+    generator_stages_t* stages; // Fused combinator stages, NULL if none
+    generator_consume_func_t consumer; // Called by yield in push and batch mode
     int64_t yielded_value; // The currently yielded value
+    int64_t sent_value; // Value passed to generator_send, returned by yield
+#ifdef GENERATOR_COMPACT
+    uint8_t state; // State of the generator, a generator_state_t
+#else
     generator_state_t state; // State of the generator
+#endif
+    bool delegated; // Last suspension was a yield_from rather than a yield
+    bool borrowed; // Control block and stack belong to the caller (generator_init)
+    bool closing; // Resumed by generator_close, see generator_is_closing
+#ifdef GENERATOR_COMPACT
+    uint32_t stack_size; // Bytes of the allocation that ends with this block
+#endif
+
+    generator_t* delegate; // Innermost yield_from target (outermost generator only)
+    bool (*pull)(generator_t* gen, int64_t* value); // Set for zip/chain, which have no stack
+    const void* ref_ptr; // Memory passed to yield_ref, NULL after a plain yield
+    size_t ref_len; // Bytes at ref_ptr
+    void* consumer_ctx;
+    generator_func_t user_func; // User-provided function
     void* user_data;
+    generator_t* delegator; // Generator running yield_from on this one
+#ifndef GENERATOR_COMPACT
+    void* stack; // Stack allocated for the generator
+    size_t stack_size; // Stack size
+    struct generator_hibernation* hibernation; // Compressed stack while GEN_HIBERNATED
+#endif
+#ifdef GENERATOR_SHARED_STACK
+    char* saved_sp; // Lowest live stack address while suspended
+    void* saved_stack; // Copy of [saved_sp, stack top) while not the occupant
+    size_t saved_size; // Bytes of saved_stack in use
+    size_t saved_capacity; // Bytes allocated for saved_stack
+    bool context_ready; // Initial frame is built on the first resume
+#endif
 };
 
-// --- Private Helper Function ---
+#ifdef GENERATOR_COMPACT
+_Static_assert(sizeof(generator_t) == 128, "compact control block is two cache lines");
+_Static_assert(offsetof(generator_t, delegate) == 64, "hot fields fill the first cache line");
+#endif
 
-// This is the actual entry point function passed to makecontext.
-// It is responsible for calling the user-provided generator function
-// and handling the state after the user function returns.
-static void generator_entry_point(void* arg)
+// --- Private Helper Functions ---
+
+static void generator_entry_point(void* arg);
+static void generator_destroy(generator_t* gen);
+static void generator_free(generator_t* gen);
+
+static inline size_t generator_page_size(void)
 {
-    generator_t* self = (generator_t*)arg;
+    static size_t page_size = 0;
+    if (page_size == 0) {
+        long sz = sysconf(_SC_PAGESIZE);
+        page_size = (sz > 0) ? (size_t)sz : 4096;
+    }
+    return page_size;
+}
 
-    // Call the user-provided generator function
-    self->user_func(self);
+#ifdef GENERATOR_MMAP_STACK
 
-    // If user_func returns, it means the generator has finished
-    self->state = GEN_FINISHED;
+// Reserves *stack_size bytes (rounded up to whole pages) plus a guard page
+// below them. Nothing is committed until the generator touches it.
+static void* generator_stack_alloc_raw(size_t* stack_size)
+{
+    size_t page = generator_page_size();
+    size_t size = (*stack_size + page - 1) & ~(page - 1);
 
-    // printf("[Generator %p] User function finished. Swapping back to caller.\n",
-    // (void*)self); Last switch back to the caller (generator_next)
-    if (swapcontext(&self->context, &self->caller_context) == -1) {
-        perror("swapcontext (generator finish -> caller) failed");
-        // Difficult to recover from this
+    char* base = (char*)mmap(NULL, size + page, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
     }
-    // Control should not return here
+    if (mprotect(base, page, PROT_NONE) == -1) {
+        munmap(base, size + page);
+        return NULL;
+    }
+
+    *stack_size = size;
+    return base + page;
 }
 
-// --- Public API Implementation ---
+static void generator_stack_free_raw(void* stack, size_t stack_size)
+{
+    size_t page = generator_page_size();
+    munmap((char*)stack - page, stack_size + page);
+}
 
-/**
- * @brief Creates a new generator.
- *
- * @param func The user-provided generator function.
- * @param user_data Optional user data to pass to the generator function.
- * @param stack_size The stack size (in bytes) for the generator coroutine.
- * Recommended at least 16KB.
- * @return A pointer to the new generator on success, or NULL on failure.
- */
-static generator_t* generator_create(generator_func_t func, void* user_data,
-    size_t stack_size)
+#else
+
+static void* generator_stack_alloc_raw(size_t* stack_size)
 {
-    if (!func) {
-        fprintf(stderr, "Error: Generator function cannot be NULL.\n");
-        return NULL;
+#ifdef GENERATOR_COMPACT
+    // The control block at the top must start on a cache line
+    *stack_size = (*stack_size + 63) & ~(size_t)63;
+    return aligned_alloc(64, *stack_size);
+#else
+    return malloc(*stack_size);
+#endif
+}
+
+static void generator_stack_free_raw(void* stack, size_t stack_size)
+{
+    (void)stack_size;
+    free(stack);
+}
+
+#endif // GENERATOR_MMAP_STACK
+
+#ifdef GENERATOR_STACK_POOL
+
+// Stacks are recycled by power-of-two size class. Each thread keeps a small
+// magazine per class that it uses without locking; magazines spill to and
+// refill from a shared depot in batches of half a magazine. A free stack is
+// linked into the depot through its top word, which is always committed.
+
+#define GENERATOR_POOL_MIN_SHIFT 12 // Smallest class: 4KB
+#define GENERATOR_POOL_CLASSES 13 // Largest class: 16MB
+
+typedef struct {
+    void* stacks[GENERATOR_POOL_MAGAZINE_SIZE];
+    size_t count;
+} generator_magazine_t;
+
+static __thread generator_magazine_t generator_magazines[GENERATOR_POOL_CLASSES];
+static __thread bool generator_pool_registered;
+
+static struct {
+    pthread_mutex_t mtx; // Protects head[]
+    void* head[GENERATOR_POOL_CLASSES]; // Depot free lists
+    atomic_size_t retained; // Bytes held in magazines and the depot
+    atomic_size_t limit; // Cap on retained bytes
+    pthread_once_t once;
+    pthread_key_t key; // Flushes a thread's magazines when it exits
+} generator_pool = {
+    PTHREAD_MUTEX_INITIALIZER, { NULL }, 0, GENERATOR_POOL_MAX_RETAINED,
+    PTHREAD_ONCE_INIT, 0
+};
+
+static inline void** generator_pool_link(void* stack, size_t class_size)
+{
+    return (void**)((char*)stack + class_size - sizeof(void*));
+}
+
+static int generator_pool_class(size_t stack_size)
+{
+    for (int cls = 0; cls < GENERATOR_POOL_CLASSES; ++cls) {
+        if (stack_size <= ((size_t)1 << (cls + GENERATOR_POOL_MIN_SHIFT))) {
+            return cls;
+        }
     }
+    return -1; // Too large to pool
+}
 
-    generator_t* gen = (generator_t*)malloc(sizeof(generator_t));
-    if (!gen) {
-        perror("malloc for generator_t failed");
-        return NULL;
+// Moves up to count stacks of one class from a magazine to the depot
+static void generator_pool_spill(generator_magazine_t* mag, int cls, size_t count)
+{
+    size_t class_size = (size_t)1 << (cls + GENERATOR_POOL_MIN_SHIFT);
+    pthread_mutex_lock(&generator_pool.mtx);
+    while (count-- > 0 && mag->count > 0) {
+        void* stack = mag->stacks[--mag->count];
+        *generator_pool_link(stack, class_size) = generator_pool.head[cls];
+        generator_pool.head[cls] = stack;
     }
+    pthread_mutex_unlock(&generator_pool.mtx);
+}
 
-    gen->stack_size = (stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE;
-    gen->stack = malloc(gen->stack_size);
-    if (!gen->stack) {
-        perror("malloc for generator stack failed");
-        free(gen);
-        return NULL;
+static void generator_pool_thread_exit(void* arg)
+{
+    generator_magazine_t* mags = (generator_magazine_t*)arg;
+    generator_pool_registered = false; // Stacks freed by later destructors re-register
+    for (int cls = 0; cls < GENERATOR_POOL_CLASSES; ++cls) {
+        generator_pool_spill(&mags[cls], cls, GENERATOR_POOL_MAGAZINE_SIZE);
     }
+}
 
-    gen->user_func = func;
-    gen->state = GEN_SUSPENDED;
-    gen->yielded_value = 0;
-    gen->user_data = user_data;
+static void generator_pool_init_key(void)
+{
+    pthread_key_create(&generator_pool.key, generator_pool_thread_exit);
+}
 
-    if (getcontext(&gen->context) == -1) {
-        perror("getcontext for generator failed");
-        free(gen->stack);
-        free(gen);
-        return NULL;
+// Makes sure whatever this thread keeps is handed back when it exits. Called
+// before a magazine first holds stacks, whether freed here or refilled from
+// the depot.
+static inline void generator_pool_register_thread(void)
+{
+    if (!generator_pool_registered) {
+        pthread_once(&generator_pool.once, generator_pool_init_key);
+        pthread_setspecific(generator_pool.key, generator_magazines);
+        generator_pool_registered = true;
+    }
+}
+
+static void* generator_stack_alloc(size_t* stack_size)
+{
+    int cls = generator_pool_class(*stack_size);
+    if (cls < 0) {
+        return generator_stack_alloc_raw(stack_size);
     }
 
-    gen->context.uc_stack.ss_sp = gen->stack;
-    gen->context.uc_stack.ss_size = gen->stack_size;
-    gen->context.uc_link = &gen->caller_context;
+    size_t class_size = (size_t)1 << (cls + GENERATOR_POOL_MIN_SHIFT);
+    generator_magazine_t* mag = &generator_magazines[cls];
+
+    if (mag->count == 0) {
+        generator_pool_register_thread();
+        pthread_mutex_lock(&generator_pool.mtx);
+        while (mag->count < GENERATOR_POOL_MAGAZINE_SIZE / 2 + 1
+            && generator_pool.head[cls]) {
+            void* stack = generator_pool.head[cls];
+            generator_pool.head[cls] = *generator_pool_link(stack, class_size);
+            mag->stacks[mag->count++] = stack;
+        }
+        pthread_mutex_unlock(&generator_pool.mtx);
+    }
 
-    makecontext(&gen->context, (void (*)(void))generator_entry_point, 1, gen);
+    *stack_size = class_size;
+    if (mag->count == 0) {
+        return generator_stack_alloc_raw(stack_size);
+    }
+    atomic_fetch_sub_explicit(&generator_pool.retained, class_size,
+        memory_order_relaxed);
+    return mag->stacks[--mag->count];
+}
 
-    return gen;
+static void generator_stack_free(void* stack, size_t stack_size)
+{
+    int cls = generator_pool_class(stack_size);
+    if (cls < 0 || stack_size != ((size_t)1 << (cls + GENERATOR_POOL_MIN_SHIFT))) {
+        generator_stack_free_raw(stack, stack_size);
+        return;
+    }
+
+    size_t limit = atomic_load_explicit(&generator_pool.limit, memory_order_relaxed);
+    size_t retained = atomic_fetch_add_explicit(&generator_pool.retained,
+        stack_size, memory_order_relaxed);
+    if (retained + stack_size > limit) {
+        atomic_fetch_sub_explicit(&generator_pool.retained, stack_size,
+            memory_order_relaxed);
+        generator_stack_free_raw(stack, stack_size);
+        return;
+    }
+
+    generator_pool_register_thread();
+
+    generator_magazine_t* mag = &generator_magazines[cls];
+    if (mag->count == GENERATOR_POOL_MAGAZINE_SIZE) {
+        generator_pool_spill(mag, cls, GENERATOR_POOL_MAGAZINE_SIZE / 2);
+    }
+    mag->stacks[mag->count++] = stack;
 }
 
 /**
- * @brief Gets the next value from the generator.
+ * @brief Sets the cap on memory retained by the stack pool and releases depot
+ * stacks until the pool is back under it. The calling thread's magazines are
+ * flushed first; stacks cached by other threads are trimmed once they spill
+ * to the depot (when their magazines fill up or the threads exit).
  *
- * @param gen Pointer to the generator to operate on.
- * @param done Output parameter. Set to true if the generator has finished
- * (function returned), false otherwise.
- * @return The yielded value if the generator is not finished. If the generator
- * is finished, the return value is undefined (often 0 or the last yielded
- * value, rely on the done flag).
+ * @param max_bytes Maximum bytes of idle stacks to keep. 0 disables pooling.
  */
-static int64_t generator_next(generator_t* gen, bool* done)
+static inline void generator_pool_set_limit(size_t max_bytes)
 {
-    if (!gen) {
-        if (done)
-            *done = true;
-        return 0;
-    }
+    atomic_store_explicit(&generator_pool.limit, max_bytes, memory_order_relaxed);
 
-    if (gen->state == GEN_FINISHED) {
-        if (done)
-            *done = true;
-        return gen->yielded_value;
+    for (int cls = 0; cls < GENERATOR_POOL_CLASSES; ++cls) {
+        generator_pool_spill(&generator_magazines[cls], cls,
+            GENERATOR_POOL_MAGAZINE_SIZE);
     }
 
-    gen->state = GEN_RUNNING;
-    if (swapcontext(&gen->caller_context, &gen->context) == -1) {
-        perror("swapcontext (caller -> generator) failed");
-        gen->state = GEN_FINISHED;
-        if (done)
-            *done = true;
-        return 0;
+    pthread_mutex_lock(&generator_pool.mtx);
+    for (int cls = GENERATOR_POOL_CLASSES - 1; cls >= 0; --cls) {
+        size_t class_size = (size_t)1 << (cls + GENERATOR_POOL_MIN_SHIFT);
+        while (generator_pool.head[cls]
+            && atomic_load_explicit(&generator_pool.retained, memory_order_relaxed) > max_bytes) {
+            void* stack = generator_pool.head[cls];
+            generator_pool.head[cls] = *generator_pool_link(stack, class_size);
+            atomic_fetch_sub_explicit(&generator_pool.retained, class_size,
+                memory_order_relaxed);
+            generator_stack_free_raw(stack, class_size);
+        }
     }
+    pthread_mutex_unlock(&generator_pool.mtx);
+}
 
-    if (done) {
-        *done = (gen->state == GEN_FINISHED);
+#else
+
+static inline void* generator_stack_alloc(size_t* stack_size)
+{
+    return generator_stack_alloc_raw(stack_size);
+}
+
+static inline void generator_stack_free(void* stack, size_t stack_size)
+{
+    generator_stack_free_raw(stack, stack_size);
+}
+
+#endif // GENERATOR_STACK_POOL
+
+#ifdef GENERATOR_ASM_SWITCH
+
+// Saves the callee-saved registers (and the FP control words) on the current
+// stack, stores the stack pointer in *from_sp, then restores the same set
+// from to_sp. Everything else is caller-saved under the SysV ABI.
+// The arguments arrive in rdi/rsi; naked bodies cannot name them.
+__attribute__((naked, noinline)) static void generator_asm_switch(
+    __attribute__((unused)) void** from_sp, __attribute__((unused)) void* to_sp)
+{
+    __asm__ volatile(
+        "pushq %rbp\n\t"
+        "pushq %rbx\n\t"
+        "pushq %r12\n\t"
+        "pushq %r13\n\t"
+        "pushq %r14\n\t"
+        "pushq %r15\n\t"
+#ifndef GENERATOR_ASM_NO_FPU
+        "subq $8, %rsp\n\t"
+        "stmxcsr (%rsp)\n\t"
+        "fnstcw 4(%rsp)\n\t"
+#endif
+        "movq %rsp, (%rdi)\n\t"
+        "movq %rsi, %rsp\n\t"
+#ifndef GENERATOR_ASM_NO_FPU
+        "ldmxcsr (%rsp)\n\t"
+        "fldcw 4(%rsp)\n\t"
+        "addq $8, %rsp\n\t"
+#endif
+        "popq %r15\n\t"
+        "popq %r14\n\t"
+        "popq %r13\n\t"
+        "popq %r12\n\t"
+        "popq %rbx\n\t"
+        "popq %rbp\n\t"
+        "ret\n\t");
+}
+
+// First "return address" of a new generator. The initial frame built by
+// generator_context_init leaves the argument in r12 and the function in r13.
+__attribute__((naked, noinline)) static void generator_asm_trampoline(void)
+{
+    __asm__ volatile(
+        "movq %r12, %rdi\n\t"
+        "callq *%r13\n\t"
+        "ud2\n\t"); // The entry point never returns
+}
+
+static int generator_context_init(generator_context_t* ctx,
+    generator_context_t* link, void* stack, size_t stack_size, void* arg)
+{
+    (void)link; // generator_entry_point switches back explicitly
+
+    // The frame is popped by generator_asm_switch: [fpu] r15 r14 r13 r12 rbx
+    // rbp ret. After the final ret the stack must be 16-byte aligned so the
+    // call in the trampoline enters the function with the ABI alignment.
+    uint64_t* top = (uint64_t*)(((uintptr_t)stack + stack_size) & ~(uintptr_t)15);
+    *--top = (uint64_t)(uintptr_t)generator_asm_trampoline;
+    *--top = 0; // rbp: terminates the frame chain for debuggers
+    *--top = 0; // rbx
+    *--top = (uint64_t)(uintptr_t)arg; // r12
+    *--top = (uint64_t)(uintptr_t)generator_entry_point; // r13
+    *--top = 0; // r14
+    *--top = 0; // r15
+#ifndef GENERATOR_ASM_NO_FPU
+    // Start with the creating thread's control words, as getcontext would
+    uint32_t fpu[2] = { 0, 0 };
+    __asm__ volatile("stmxcsr %0\n\tfnstcw %1" : "=m"(fpu[0]), "=m"(fpu[1]));
+    *--top = (uint64_t)fpu[0] | ((uint64_t)fpu[1] << 32);
+#endif
+    ctx->sp = top;
+    return 0;
+}
+
+static inline int generator_context_switch(generator_context_t* from,
+    generator_context_t* to)
+{
+    generator_asm_switch(&from->sp, to->sp);
+    return 0;
+}
+
+#else // ucontext backend
+
+// getcontext costs a sigprocmask system call, so it runs once per thread to
+// fill a template; new contexts are copies of it. They start with the signal
+// mask and floating point environment the thread had at its first create.
+static __thread generator_context_t generator_context_template;
+static __thread bool generator_context_template_ready;
+
+static int generator_context_init(generator_context_t* ctx,
+    generator_context_t* link, void* stack, size_t stack_size, void* arg)
+{
+    if (!generator_context_template_ready) {
+        if (getcontext(&generator_context_template) == -1) {
+            return -1;
+        }
+        generator_context_template_ready = true;
     }
 
-    return gen->yielded_value;
+    memcpy(ctx, &generator_context_template, sizeof(generator_context_t));
+#if defined(__x86_64__) && defined(__GLIBC__)
+    // The saved FP state is reached through a pointer into the context itself
+#ifdef __USE_MISC
+    ctx->uc_mcontext.fpregs = &ctx->__fpregs_mem;
+#else
+    ctx->uc_mcontext.__fpregs = &ctx->__fpregs_mem;
+#endif
+#endif
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = stack_size;
+    ctx->uc_link = link;
+
+    makecontext(ctx, (void (*)(void))generator_entry_point, 1, arg);
+    return 0;
 }
 
-/**
- * @brief Called from within the generator function to suspend the generator and
- * return a value to the caller.
- *        **Note: This function should only be called by the user-provided
- * generator function.**
- *
- * @param self Pointer to the currently executing generator object (received by
- * the generator function).
- * @param value The value to yield.
- */
-static void yield(generator_t* self, int64_t value)
+static inline int generator_context_switch(generator_context_t* from,
+    generator_context_t* to)
 {
-    if (!self || self->state != GEN_RUNNING) {
-        fprintf(stderr, "Error: yield() called outside of a running generator "
-                        "context or with invalid generator.\n");
-        return;
+    return swapcontext(from, to);
+}
+
+#endif // GENERATOR_ASM_SWITCH
+
+#ifdef GENERATOR_SHARED_STACK
+
+// Bytes below a marker local that yield() may still use while switching out
+#define GENERATOR_SHARED_STACK_SLACK 256
+
+// The generator whose frames are currently on the shared stack is its
+// occupant. It is only copied out when a different generator is resumed.
+static __thread struct {
+    void* stack;
+    size_t stack_size;
+    generator_t* occupant;
+} generator_shared;
+
+static void* generator_shared_stack(size_t* stack_size)
+{
+    if (!generator_shared.stack) {
+        size_t size = GENERATOR_SHARED_STACK_SIZE;
+        generator_shared.stack = generator_stack_alloc_raw(&size);
+        generator_shared.stack_size = size;
     }
+    *stack_size = generator_shared.stack_size;
+    return generator_shared.stack;
+}
 
-    self->yielded_value = value;
-    self->state = GEN_SUSPENDED;
+static bool generator_shared_save(generator_t* gen)
+{
+#ifdef GENERATOR_ASM_SWITCH
+    gen->saved_sp = (char*)gen->context.sp; // Exact: the switch frame is the lowest
+#endif
+    size_t size = (size_t)((char*)gen->stack + gen->stack_size - gen->saved_sp);
 
-    if (swapcontext(&self->context, &self->caller_context) == -1) {
-        perror("swapcontext (yield -> caller) failed");
-        self->state = GEN_FINISHED;
+    // Keep the buffer right-sized: grow on demand, shrink when mostly unused
+    if (size > gen->saved_capacity || size < gen->saved_capacity / 2) {
+        void* buf = realloc(gen->saved_stack, size);
+        if (!buf) {
+            return false;
+        }
+        gen->saved_stack = buf;
+        gen->saved_capacity = size;
     }
+
+    memcpy(gen->saved_stack, gen->saved_sp, size);
+    gen->saved_size = size;
+    return true;
 }
 
-/**
- * @brief Destroys the generator and releases its resources (including the
- * stack).
- *
- * @param gen Pointer to the generator to destroy.
- */
-static void generator_destroy(generator_t* gen)
+// Makes gen the occupant of the shared stack, copying out the previous one
+static bool generator_shared_enter(generator_t* gen)
 {
-    if (gen) {
-        if (gen->stack) {
-            free(gen->stack);
+    generator_t* occupant = generator_shared.occupant;
+    if (occupant == gen) {
+        return true;
+    }
+
+    if (occupant && occupant->state == GEN_RUNNING) {
+        fprintf(stderr, "Error: a shared-stack generator cannot resume another "
+                        "shared-stack generator.\n");
+        return false;
+    }
+    if (occupant && occupant->state != GEN_FINISHED
+        && !generator_shared_save(occupant)) {
+        perror("realloc for saved generator stack failed");
+        return false;
+    }
+    generator_shared.occupant = NULL;
+
+    if (gen->context_ready) {
+        memcpy(gen->saved_sp, gen->saved_stack, gen->saved_size);
+    } else {
+        if (generator_context_init(&gen->context, &gen->caller_context,
+                gen->stack, gen->stack_size, gen)
+            == -1) {
+            perror("getcontext for generator failed");
+            return false;
         }
-        free(gen);
+        gen->context_ready = true;
     }
+
+    generator_shared.occupant = gen;
+    return true;
+}
+
+#endif // GENERATOR_SHARED_STACK
+
+// This is the actual entry point function passed to makecontext.
+// It is responsible for calling the user-provided generator function
+// and handling the state after the user function returns.
+static void generator_entry_point(void* arg)
+{
+    generator_t* self = (generator_t*)arg;
+
+    // Call the user-provided generator function
+    self->user_func(self);
+
+    // If user_func returns, it means the generator has finished. A generator
+    // reached through generator_transfer also ends the chain it was part of.
+    generator_t* origin = self->origin;
+    self->state = GEN_FINISHED;
+    origin->state = GEN_FINISHED;
+
+    // printf("[Generator %p] User function finished. Swapping back to caller.\n",
+    // (void*)self); Last switch back to the caller (generator_next)
+    if (generator_context_switch(&self->context, &origin->caller_context) == -1) {
+        perror("swapcontext (generator finish -> caller) failed");
+        // Difficult to recover from this
+    }
+    // Control should not return here
+}
+
+// Ends the running generator self without returning from its function, as
+// if it had finished; whatever is left on its stack is abandoned
+static void generator_abandon(generator_t* self)
+{
+    generator_t* origin = self->origin;
+    self->state = GEN_FINISHED;
+    origin->state = GEN_FINISHED;
+    if (generator_context_switch(&self->context, &origin->caller_context) == -1) {
+        perror("swapcontext (yield -> caller) failed");
+    }
+}
+
+#ifdef GENERATOR_COMPACT
+// The control block is the top of its own stack allocation
+static inline void* generator_stack_base(generator_t* gen)
+{
+    return (char*)gen + sizeof(generator_t) - gen->stack_size;
+}
+
+static inline size_t generator_stack_usable(generator_t* gen)
+{
+    return gen->stack_size - sizeof(generator_t);
+}
+#else
+static inline void* generator_stack_base(generator_t* gen)
+{
+    return gen->stack;
+}
+
+static inline size_t generator_stack_usable(generator_t* gen)
+{
+    return gen->stack_size;
+}
+#endif
+
+// Lowest stack address a suspended generator still uses, NULL if it cannot
+// be found out in this configuration
+static inline char* generator_suspended_sp(generator_t* gen)
+{
+#ifdef GENERATOR_ASM_SWITCH
+    return (char*)gen->context.sp;
+#elif defined(__x86_64__) && defined(__GLIBC__)
+#ifdef __USE_MISC
+    return (char*)(uintptr_t)gen->context.uc_mcontext.gregs[15]; // REG_RSP
+#else
+    return (char*)(uintptr_t)gen->context.uc_mcontext.__gregs[15];
+#endif
+#else
+    (void)gen;
+    return NULL;
+#endif
+}
+
+#ifdef GENERATOR_STACK_STATS
+
+#define GENERATOR_STACK_PAINT 0xA5A5A5A5A5A5A5A5ull
+
+typedef struct {
+    _Atomic(generator_func_t) func; // Function measured in this slot
+    atomic_size_t count; // Generators measured
+    atomic_size_t total_peak; // Sum of their peaks, for the mean
+    atomic_size_t max_peak; // Largest peak seen
+} generator_stack_stats_slot_t;
+
+static generator_stack_stats_slot_t generator_stack_stats_table[GENERATOR_STACK_STATS_FUNCS];
+
+// Finds the slot of func, claiming a free one if claim is set. NULL if the
+// table is full.
+static generator_stack_stats_slot_t* generator_stack_stats_slot(
+    generator_func_t func, bool claim)
+{
+    size_t start = ((uintptr_t)func >> 4) % GENERATOR_STACK_STATS_FUNCS;
+    for (size_t i = 0; i < GENERATOR_STACK_STATS_FUNCS; ++i) {
+        generator_stack_stats_slot_t* slot
+            = &generator_stack_stats_table[(start + i) % GENERATOR_STACK_STATS_FUNCS];
+        generator_func_t seen = atomic_load(&slot->func);
+        if (seen == func) {
+            return slot;
+        }
+        if (!seen) {
+            if (!claim) {
+                return NULL;
+            }
+            if (atomic_compare_exchange_strong(&slot->func, &seen, func) || seen == func) {
+                return slot;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Fills the usable stack with the paint pattern, so that the deepest word
+// the generator overwrites marks its peak
+static void generator_stack_paint(generator_t* gen)
+{
+    uintptr_t base = (uintptr_t)generator_stack_base(gen);
+    uint64_t* word = (uint64_t*)((base + 7) & ~(uintptr_t)7);
+    uint64_t* end = (uint64_t*)((base + generator_stack_usable(gen)) & ~(uintptr_t)7);
+    while (word < end) {
+        *word++ = GENERATOR_STACK_PAINT;
+    }
+}
+
+// Bytes from the top of the stack down to the deepest overwritten word
+static size_t generator_stack_measure(generator_t* gen)
+{
+    uintptr_t base = (uintptr_t)generator_stack_base(gen);
+    uint64_t* word = (uint64_t*)((base + 7) & ~(uintptr_t)7);
+    uint64_t* end = (uint64_t*)((base + generator_stack_usable(gen)) & ~(uintptr_t)7);
+    while (word < end && *word == GENERATOR_STACK_PAINT) {
+        ++word;
+    }
+    return (size_t)((char*)end - (char*)word);
+}
+
+// Adds the peak of a run that is over to the statistics of its function
+static void generator_stack_record(generator_t* gen)
+{
+    if (!gen->origin || gen->state == GEN_HIBERNATED) {
+        return; // Never ran, or its stack is compressed away
+    }
+    generator_stack_stats_slot_t* slot = generator_stack_stats_slot(gen->user_func, true);
+    if (!slot) {
+        return;
+    }
+    size_t peak = generator_stack_measure(gen);
+    atomic_fetch_add(&slot->count, 1);
+    atomic_fetch_add(&slot->total_peak, peak);
+    size_t max = atomic_load(&slot->max_peak);
+    while (peak > max && !atomic_compare_exchange_weak(&slot->max_peak, &max, peak)) {
+    }
+}
+
+#ifdef GENERATOR_STACK_AUTOTUNE
+// Stack size for a new generator of func: what the measured runs needed
+// plus headroom, never more than requested (0 for the default)
+static size_t generator_autotune_size(generator_func_t func, size_t requested)
+{
+    size_t limit = (requested > 0) ? requested : DEFAULT_STACK_SIZE;
+    generator_stack_stats_slot_t* slot = generator_stack_stats_slot(func, false);
+    if (!slot || atomic_load(&slot->count) < GENERATOR_AUTOTUNE_MIN_SAMPLES) {
+        return requested;
+    }
+    size_t peak = atomic_load(&slot->max_peak);
+    size_t size = peak + peak * GENERATOR_AUTOTUNE_HEADROOM / 100 + GENERATOR_AUTOTUNE_SLACK;
+    size = (size + 1023) & ~(size_t)1023;
+#ifdef GENERATOR_COMPACT
+    size += sizeof(generator_t);
+#endif
+    return (size < limit) ? size : limit;
+}
+#endif
+
+#endif // GENERATOR_STACK_STATS
+
+// --- Stack Compression ---
+// A byte-oriented LZ77 codec in the LZF format, used by generator_hibernate.
+// Suspended stacks are mostly zeros, small integers and repeated pointers,
+// which it packs several-fold at memcpy-like speed. Each control byte is
+// either a literal run (0-31: copy that many + 1 bytes) or a back-reference:
+// length - 2 in the top 3 bits (7: one more length byte follows) and a
+// 13-bit distance - 1 split over the low 5 bits and the next byte.
+
+#define GENERATOR_LZ_HASH_BITS 12
+#define GENERATOR_LZ_MAX_DISTANCE (1 << 13)
+#define GENERATOR_LZ_MAX_MATCH (7 + 255 + 2)
+
+// Last position of each 3-byte hash. Never cleared: stale entries are
+// verified against the input like any other candidate.
+static __thread uint32_t generator_lz_table[1 << GENERATOR_LZ_HASH_BITS];
+
+static inline uint32_t generator_lz_hash(const unsigned char* p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GENERATOR_LZ_HASH_BITS);
+}
+
+// Appends the literals [from, to) to out. Returns false if cap is exceeded.
+static inline bool generator_lz_literals(const unsigned char* from,
+    const unsigned char* to, unsigned char* out, size_t cap, size_t* op)
+{
+    while (from < to) {
+        size_t run = ((size_t)(to - from) < 32) ? (size_t)(to - from) : 32;
+        if (*op + 1 + run > cap) {
+            return false;
+        }
+        out[(*op)++] = (unsigned char)(run - 1);
+        memcpy(out + *op, from, run);
+        *op += run;
+        from += run;
+    }
+    return true;
+}
+
+// Compresses n bytes of in into out. Returns the compressed size, or 0 if
+// it would not fit in cap bytes.
+static inline size_t generator_lz_compress(const void* in, size_t n, void* out,
+    size_t cap)
+{
+    const unsigned char* src = (const unsigned char*)in;
+    unsigned char* dst = (unsigned char*)out;
+    size_t ip = 0, lit = 0, op = 0;
+
+    while (ip + 2 < n) {
+        uint32_t* entry = &generator_lz_table[generator_lz_hash(src + ip)];
+        size_t ref = *entry;
+        *entry = (uint32_t)ip;
+        if (ref < ip && ip - ref <= GENERATOR_LZ_MAX_DISTANCE
+            && memcmp(src + ref, src + ip, 3) == 0) {
+            size_t max = (n - ip < GENERATOR_LZ_MAX_MATCH) ? n - ip : GENERATOR_LZ_MAX_MATCH;
+            size_t len = 3;
+            while (len < max && src[ref + len] == src[ip + len]) {
+                ++len;
+            }
+            if (!generator_lz_literals(src + lit, src + ip, dst, cap, &op)
+                || op + 3 > cap) {
+                return 0;
+            }
+            size_t dist = ip - ref - 1;
+            size_t code = len - 2;
+            if (code < 7) {
+                dst[op++] = (unsigned char)((code << 5) | (dist >> 8));
+            } else {
+                dst[op++] = (unsigned char)((7 << 5) | (dist >> 8));
+                dst[op++] = (unsigned char)(code - 7);
+            }
+            dst[op++] = (unsigned char)(dist & 0xff);
+            ip += len;
+            lit = ip;
+        } else {
+            ++ip;
+        }
+    }
+    if (!generator_lz_literals(src + lit, src + n, dst, cap, &op)) {
+        return 0;
+    }
+    return op;
+}
+
+// Decompresses n bytes of in into exactly size bytes at out. Returns false
+// if the input is malformed.
+static inline bool generator_lz_decompress(const void* in, size_t n, void* out,
+    size_t size)
+{
+    const unsigned char* src = (const unsigned char*)in;
+    unsigned char* dst = (unsigned char*)out;
+    size_t ip = 0, op = 0;
+
+    while (ip < n) {
+        size_t ctrl = src[ip++];
+        if (ctrl < 32) {
+            size_t run = ctrl + 1;
+            if (ip + run > n || op + run > size) {
+                return false;
+            }
+            memcpy(dst + op, src + ip, run);
+            ip += run;
+            op += run;
+            continue;
+        }
+        size_t len = ctrl >> 5;
+        if (len == 7) {
+            if (ip >= n) {
+                return false;
+            }
+            len += src[ip++];
+        }
+        len += 2;
+        if (ip >= n) {
+            return false;
+        }
+        size_t dist = ((ctrl & 31) << 8) + src[ip++] + 1;
+        if (dist > op || op + len > size) {
+            return false;
+        }
+        for (size_t i = 0; i < len; ++i, ++op) {
+            dst[op] = dst[op - dist]; // May overlap: runs repeat their start
+        }
+    }
+    return op == size;
+}
+
+// Compressed image of the live part of a hibernating generator's stack
+typedef struct generator_hibernation {
+    size_t live; // Bytes of stack image, ending at the top of the stack
+    size_t packed; // Bytes in data; equal to live if stored uncompressed
+    unsigned char data[];
+} generator_hibernation_t;
+
+// Where a hibernating generator keeps its image
+static inline generator_hibernation_t** generator_hibernation_slot(generator_t* gen)
+{
+#ifdef GENERATOR_COMPACT
+    // Just below the control block, on a page that is never released
+    return (generator_hibernation_t**)((char*)gen - sizeof(void*));
+#else
+    return &gen->hibernation;
+#endif
+}
+
+// Puts the stack image of a hibernating generator back in place. Returns
+// false, with gen finished, if the image is damaged.
+static bool generator_rehydrate(generator_t* gen)
+{
+    generator_hibernation_t* image = *generator_hibernation_slot(gen);
+    char* top = (char*)generator_stack_base(gen) + generator_stack_usable(gen);
+    bool ok = true;
+    if (image->packed == image->live) {
+        memcpy(top - image->live, image->data, image->live);
+    } else {
+        ok = generator_lz_decompress(image->data, image->packed,
+            top - image->live, image->live);
+    }
+    free(image);
+#ifndef GENERATOR_COMPACT
+    gen->hibernation = NULL;
+#endif
+    if (!ok) {
+        fprintf(stderr, "Error: hibernated generator stack is damaged.\n");
+        gen->state = GEN_FINISHED;
+        return false;
+    }
+    gen->state = GEN_SUSPENDED;
+    return true;
+}
+
+#ifdef GENERATOR_LAZY_STACK
+// Gives a generator that has not run yet its stack and initial context.
+// Returns false, with gen finished, if that fails.
+static bool generator_lazy_stack(generator_t* gen)
+{
+    gen->stack = generator_stack_alloc(&gen->stack_size);
+    if (!gen->stack) {
+        perror("allocation of generator stack failed");
+        gen->state = GEN_FINISHED;
+        return false;
+    }
+#ifdef GENERATOR_STACK_STATS
+    generator_stack_paint(gen);
+#endif
+    if (generator_context_init(&gen->context, &gen->caller_context,
+            gen->stack, gen->stack_size, gen)
+        == -1) {
+        perror("getcontext for generator failed");
+        gen->state = GEN_FINISHED;
+        return false;
+    }
+    return true;
+}
+#endif
+
+// Switches into gen until it yields or finishes. Returns false (with gen
+// marked finished where appropriate) if the switch could not be made.
+static bool generator_resume(generator_t* gen)
+{
+#ifdef GENERATOR_SHARED_STACK
+    if (!generator_shared_enter(gen)) {
+        return false;
+    }
+#endif
+#ifdef GENERATOR_LAZY_STACK
+    if (!gen->stack && !generator_lazy_stack(gen)) {
+        return false;
+    }
+#endif
+    if (gen->state == GEN_HIBERNATED && !generator_rehydrate(gen)) {
+        return false;
+    }
+
+    gen->state = GEN_RUNNING;
+    gen->origin = gen;
+    if (generator_context_switch(&gen->caller_context, &gen->context) == -1) {
+        perror("swapcontext (caller -> generator) failed");
+        gen->state = GEN_FINISHED;
+        return false;
+    }
+    return true;
+}
+
+// Passes value through the stages in order. Returns false if a stage dropped
+// it; stages->exhausted then tells whether the generator is used up.
+static bool generator_apply_stages(generator_stages_t* stages, int64_t* value)
+{
+    for (size_t i = 0; i < stages->count; ++i) {
+        generator_stage_t* stage = &stages->stage[i];
+        switch (stage->kind) {
+        case GEN_STAGE_MAP:
+            *value = stage->func.map(*value, stage->ctx);
+            break;
+        case GEN_STAGE_FILTER:
+            if (!stage->func.filter(*value, stage->ctx)) {
+                return false;
+            }
+            break;
+        case GEN_STAGE_TAKE:
+            if (stage->count == 0) {
+                stages->exhausted = true;
+                return false;
+            }
+            if (--stage->count == 0) {
+                stages->exhausted = true; // This value is the last one
+            }
+            break;
+        case GEN_STAGE_ENUMERATE:
+            *value = stage->func.combine((int64_t)stage->count++, *value, stage->ctx);
+            break;
+        }
+    }
+    return true;
+}
+
+// True once gen has finished or reached a generator_take limit (it then stays suspended for generator_close)
+static inline bool generator_spent(const generator_t* gen)
+{
+    return gen->state == GEN_FINISHED || (gen->stages && gen->stages->exhausted);
+}
+
+// Produces the next value of a zip/chain generator, which has no context of
+// its own: its inputs are pulled and its stages applied right here.
+static void generator_pull_next(generator_t* gen)
+{
+    int64_t value = 0;
+    gen->state = GEN_RUNNING;
+    while (gen->pull(gen, &value)) {
+        if (!gen->stages || generator_apply_stages(gen->stages, &value)) {
+            gen->yielded_value = value;
+            gen->state = GEN_SUSPENDED;
+            return;
+        }
+        if (gen->stages->exhausted) {
+            break;
+        }
+    }
+    gen->state = GEN_FINISHED;
+}
+
+// Runs gen until a value is produced or gen finishes. While gen is inside a
+// yield_from chain the innermost generator is resumed directly; when it
+// finishes (or reaches a generator_take limit of its own), its delegator
+// continues from yield_from. Any consumer of gen is lent to whichever
+// generator is running; each keeps its own stages, which yield applies.
+static bool generator_step(generator_t* gen)
+{
+    for (;;) {
+        generator_t* target = gen->delegate ? gen->delegate : gen;
+        if (target != gen && generator_spent(target)) {
+            generator_t* parent = target->delegator; // Done: unlink it
+            target->delegator = NULL;
+            gen->delegate = (parent == gen) ? NULL : parent;
+            continue;
+        }
+        if (target != gen) {
+            target->sent_value = gen->sent_value;
+            target->closing = gen->closing;
+            target->consumer = gen->consumer;
+            target->consumer_ctx = gen->consumer_ctx;
+        }
+
+        bool ok = generator_resume(target);
+        bool stopped = !target->consumer; // Cleared by yield when told to stop
+
+        if (target != gen) {
+            gen->yielded_value = target->yielded_value;
+            gen->ref_ptr = target->ref_ptr;
+            gen->ref_len = target->ref_len;
+            target->consumer = NULL;
+        }
+        if (!ok) {
+            return false;
+        }
+        if (target->state == GEN_FINISHED && gen->stages && gen->stages->exhausted) {
+            gen->state = GEN_FINISHED; // A take limit ended the whole chain
+            return true;
+        }
+
+        if (target->delegated) {
+            target->delegated = false; // target linked a new innermost generator
+            continue;
+        }
+        if (target != gen && target->state == GEN_FINISHED) {
+            continue; // Unlinked at the top of the loop
+        }
+        if (target != gen && gen->consumer && !stopped && generator_spent(target)) {
+            continue; // The consumer took the delegate's last value and wants more
+        }
+        return true;
+    }
+}
+
+// (Re)initializes everything but the stack for a fresh run of func and
+// builds the initial context on the stack gen already owns
+static bool generator_prepare(generator_t* gen, generator_func_t func,
+    void* user_data)
+{
+    gen->user_func = func;
+    gen->state = GEN_SUSPENDED;
+    gen->yielded_value = 0;
+    gen->sent_value = 0;
+    gen->ref_ptr = NULL;
+    gen->ref_len = 0;
+    gen->user_data = user_data;
+    gen->consumer = NULL;
+    gen->consumer_ctx = NULL;
+    gen->delegate = NULL;
+    gen->delegator = NULL;
+    gen->delegated = false;
+    gen->closing = false;
+    gen->origin = NULL; // Set by the first resume (or transfer)
+    gen->stages = NULL;
+    gen->pull = NULL;
+
+#ifdef GENERATOR_SHARED_STACK
+    // The shared stack may be occupied: build the frame on the first resume
+    gen->saved_sp = NULL;
+    gen->saved_size = 0;
+    gen->context_ready = false;
+#else
+#ifdef GENERATOR_LAZY_STACK
+    if (!gen->stack) {
+        return true; // Not resumed yet: the context is built with the stack
+    }
+#endif
+#ifdef GENERATOR_STACK_STATS
+    generator_stack_paint(gen);
+#endif
+    if (generator_context_init(&gen->context, &gen->caller_context,
+            generator_stack_base(gen), generator_stack_usable(gen), gen)
+        == -1) {
+        perror("getcontext for generator failed");
+        gen->state = GEN_FINISHED;
+        return false;
+    }
+#endif
+    return true;
+}
+
+#ifdef GENERATOR_FREE_LIST
+
+typedef struct {
+    generator_func_t func; // Function whose generators are kept here
+    size_t count;
+    generator_t* gens[GENERATOR_FREE_LIST_SIZE];
+} generator_free_list_t;
+
+static __thread generator_free_list_t generator_free_lists[GENERATOR_FREE_LIST_FUNCS];
+static __thread bool generator_free_list_registered;
+static pthread_once_t generator_free_list_once = PTHREAD_ONCE_INIT;
+static pthread_key_t generator_free_list_key; // Frees a thread's lists when it exits
+
+// Finds the list for func. With claim, an empty list of another function is
+// taken over; a busy one is left alone and NULL returned.
+static generator_free_list_t* generator_free_list(generator_func_t func,
+    bool claim)
+{
+    size_t slot = ((uintptr_t)func >> 4) % GENERATOR_FREE_LIST_FUNCS;
+    generator_free_list_t* list = &generator_free_lists[slot];
+    if (list->func == func) {
+        return list;
+    }
+    if (claim && list->count == 0) {
+        list->func = func;
+        return list;
+    }
+    return NULL;
+}
+
+static void generator_free_list_release(generator_free_list_t* lists)
+{
+    for (size_t slot = 0; slot < GENERATOR_FREE_LIST_FUNCS; ++slot) {
+        generator_free_list_t* list = &lists[slot];
+        while (list->count > 0) {
+            generator_free(list->gens[--list->count]);
+        }
+        list->func = NULL;
+    }
+}
+
+static void generator_free_list_thread_exit(void* arg)
+{
+    generator_free_list_registered = false;
+    generator_free_list_release((generator_free_list_t*)arg);
+}
+
+static void generator_free_list_init_key(void)
+{
+    pthread_key_create(&generator_free_list_key, generator_free_list_thread_exit);
+}
+
+// Makes sure whatever this thread parks is freed when it exits
+static inline void generator_free_list_register_thread(void)
+{
+    if (!generator_free_list_registered) {
+        pthread_once(&generator_free_list_once, generator_free_list_init_key);
+        pthread_setspecific(generator_free_list_key, generator_free_lists);
+        generator_free_list_registered = true;
+    }
+}
+
+#endif // GENERATOR_FREE_LIST
+
+// --- Public API Implementation ---
+
+/**
+ * @brief Creates a new generator.
+ *
+ * @param func The user-provided generator function.
+ * @param user_data Optional user data to pass to the generator function.
+ * @param stack_size The stack size (in bytes) for the generator coroutine.
+ * Recommended at least 16KB.
+ * @return A pointer to the new generator on success, or NULL on failure.
+ */
+static inline generator_t* generator_create(generator_func_t func,
+    void* user_data, size_t stack_size)
+{
+    if (!func) {
+        fprintf(stderr, "Error: Generator function cannot be NULL.\n");
+        return NULL;
+    }
+#ifdef GENERATOR_STACK_AUTOTUNE
+    stack_size = generator_autotune_size(func, stack_size);
+#endif
+
+#ifdef GENERATOR_FREE_LIST
+    generator_free_list_t* list = generator_free_list(func, false);
+    if (list && list->count > 0) {
+        generator_t* gen = list->gens[list->count - 1];
+#ifdef GENERATOR_COMPACT
+        // A compact stack_size covers the control block too
+        if (gen->stack_size >= ((stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE))
+#elif !defined(GENERATOR_SHARED_STACK)
+        if (generator_stack_usable(gen) >= ((stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE))
+#endif
+        {
+            list->count--;
+            if (generator_prepare(gen, func, user_data)) {
+                return gen;
+            }
+            generator_free(gen);
+        }
+    }
+#endif
+
+#ifdef GENERATOR_COMPACT
+    size_t size = (stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE;
+    if (size > UINT32_MAX || size < 2 * sizeof(generator_t)) {
+        fprintf(stderr, "Error: GENERATOR_COMPACT stack sizes must be between "
+                        "256 bytes and 4GB.\n");
+        return NULL;
+    }
+    char* stack = (char*)generator_stack_alloc(&size);
+    if (!stack) {
+        perror("allocation of generator stack failed");
+        return NULL;
+    }
+    generator_t* gen = (generator_t*)(stack + size - sizeof(generator_t));
+    gen->stack_size = (uint32_t)size;
+    gen->borrowed = false;
+    if (!generator_prepare(gen, func, user_data)) {
+        generator_stack_free(stack, size);
+        return NULL;
+    }
+    return gen;
+#else
+    generator_t* gen = (generator_t*)malloc(sizeof(generator_t));
+    if (!gen) {
+        perror("malloc for generator_t failed");
+        return NULL;
+    }
+
+    gen->borrowed = false;
+#ifdef GENERATOR_SHARED_STACK
+    (void)stack_size;
+    gen->stack = generator_shared_stack(&gen->stack_size);
+#elif defined(GENERATOR_LAZY_STACK)
+    gen->stack_size = (stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE;
+    gen->stack = NULL; // Allocated by the first resume
+#else
+    gen->stack_size = (stack_size > 0) ? stack_size : DEFAULT_STACK_SIZE;
+    gen->stack = generator_stack_alloc(&gen->stack_size);
+#endif
+#ifndef GENERATOR_LAZY_STACK
+    if (!gen->stack) {
+        perror("allocation of generator stack failed");
+        free(gen);
+        return NULL;
+    }
+#endif
+
+#ifdef GENERATOR_SHARED_STACK
+    gen->saved_stack = NULL;
+    gen->saved_capacity = 0;
+#endif
+    if (!generator_prepare(gen, func, user_data)) {
+        generator_free(gen);
+        return NULL;
+    }
+
+    return gen;
+#endif // GENERATOR_COMPACT
+}
+
+/**
+ * @brief Initializes a generator in caller-provided memory, so that neither
+ * the control block nor the stack touches the heap. Both may be static or
+ * live in the caller's frame, and must outlive the generator. Call
+ * generator_destroy when done: it releases only what the library attached
+ * (combinator stages, GENERATOR_SHARED_STACK copies) and leaves the memory to
+ * the caller, which may then initialize it again.
+ *
+ * With GENERATOR_COMPACT the control block must directly follow the stack
+ * buffer (see GENERATOR_STORAGE). With GENERATOR_SHARED_STACK the stack
+ * buffer is unused and may be NULL. GENERATOR_MMAP_STACK guard pages are not
+ * added to caller memory.
+ *
+ * @param gen Storage for the control block.
+ * @param stack Stack buffer for the generator, 16-byte aligned.
+ * @param stack_size Size of the stack buffer in bytes.
+ * @param func The user-provided generator function.
+ * @param user_data Optional user data to pass to the generator function.
+ * @return true on success, false on failure.
+ */
+static inline bool generator_init(generator_t* gen, void* stack,
+    size_t stack_size, generator_func_t func, void* user_data)
+{
+    if (!gen || !func) {
+        fprintf(stderr, "Error: generator_init() needs storage and a function.\n");
+        return false;
+    }
+#ifdef GENERATOR_SHARED_STACK
+    (void)stack;
+    (void)stack_size;
+    if (generator_shared.occupant == gen) {
+        generator_shared.occupant = NULL; // Its frames are dead
+    }
+    gen->stack = generator_shared_stack(&gen->stack_size);
+    if (!gen->stack) {
+        perror("allocation of shared generator stack failed");
+        return false;
+    }
+    gen->saved_stack = NULL;
+    gen->saved_capacity = 0;
+#else
+    if (!stack || stack_size < 256) {
+        fprintf(stderr, "Error: generator_init() needs a stack of at least "
+                        "256 bytes.\n");
+        return false;
+    }
+#ifdef GENERATOR_COMPACT
+    if ((char*)gen != (char*)stack + stack_size
+        || stack_size > UINT32_MAX - sizeof(generator_t)) {
+        fprintf(stderr, "Error: with GENERATOR_COMPACT the control block must "
+                        "directly follow a stack buffer below 4GB.\n");
+        return false;
+    }
+    gen->stack_size = (uint32_t)(stack_size + sizeof(generator_t));
+#else
+    gen->stack = stack;
+    gen->stack_size = stack_size;
+#endif
+#endif // GENERATOR_SHARED_STACK
+    gen->borrowed = true;
+    return generator_prepare(gen, func, user_data);
+}
+
+// Caller-provided memory for one generator with a stack of stack_size bytes
+// (rounded up to 16), laid out for generator_init in every configuration:
+//
+//   GENERATOR_STORAGE(32 * 1024) walk; // In the caller's frame
+//   generator_init(&walk.gen, walk.stack, sizeof(walk.stack), func, data);
+#define GENERATOR_STORAGE(stack_size)                                \
+    struct {                                                         \
+        _Alignas(64) char stack[((stack_size) + 15) & ~(size_t)15]; \
+        generator_t gen;                                             \
+    }
+
+// Defines a generator in static storage and name_init(func, user_data),
+// which initializes it and returns it (NULL on failure). There is one
+// generator per definition; name_init may be called again after
+// generator_destroy.
+#define GENERATOR_STATIC_DEFINE(name, stack_size)                                 \
+    static GENERATOR_STORAGE(stack_size) name##_storage;                          \
+    static inline generator_t* name##_init(generator_func_t func, void* user_data) \
+    {                                                                             \
+        return generator_init(&name##_storage.gen, name##_storage.stack,          \
+                   sizeof(name##_storage.stack), func, user_data)                 \
+            ? &name##_storage.gen                                                 \
+            : NULL;                                                               \
+    }
+
+/**
+ * @brief Resumes the generator with a value and gets the next value from it.
+ *        The value is returned by the yield() the generator is suspended in;
+ *        the one that starts the generator is readable as self->sent_value.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param sent The value to send.
+ * @param done Output parameter. Set to true if the generator has finished
+ * (function returned), false otherwise.
+ * @return The yielded value if the generator is not finished. If the generator
+ * is finished, the return value is undefined (often 0 or the last yielded
+ * value, rely on the done flag).
+ */
+static inline int64_t generator_send(generator_t* gen, int64_t sent, bool* done)
+{
+    if (!gen) {
+        if (done)
+            *done = true;
+        return 0;
+    }
+
+    if (generator_spent(gen)) {
+        if (done)
+            *done = true;
+        return gen->yielded_value;
+    }
+
+    gen->sent_value = sent;
+    if (gen->pull) {
+        generator_pull_next(gen);
+    } else if (!generator_step(gen)) {
+        if (done)
+            *done = true;
+        return 0;
+    }
+
+    if (done) {
+        *done = (gen->state == GEN_FINISHED);
+    }
+
+    return gen->yielded_value;
+}
+
+/**
+ * @brief Gets the next value from the generator. Same as sending 0.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param done Output parameter. Set to true if the generator has finished
+ * (function returned), false otherwise.
+ * @return The yielded value if the generator is not finished. If the generator
+ * is finished, the return value is undefined (often 0 or the last yielded
+ * value, rely on the done flag).
+ */
+static int64_t generator_next(generator_t* gen, bool* done)
+{
+    return generator_send(gen, 0, done);
+}
+
+/**
+ * @brief Gets the next value from the generator as a reference. If the
+ * generator produced it with yield_ref() (or yield_span()), the pointer refers
+ * to the generator's own memory, possibly its stack, and nothing is copied.
+ * It stays valid until the generator is resumed or destroyed; with
+ * GENERATOR_SHARED_STACK, also only until another generator of the thread is
+ * resumed. Copy whatever must outlive that.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param len Output parameter, set to the length in bytes (0 if none).
+ * @param done Output parameter. Set to true if the generator has finished.
+ * @return The referenced memory, or NULL if the generator finished or yielded
+ * a plain value with yield().
+ */
+static inline const void* generator_next_ref(generator_t* gen, size_t* len,
+    bool* done)
+{
+    bool finished = true;
+    if (gen) {
+        gen->ref_ptr = NULL;
+        gen->ref_len = 0;
+        generator_next(gen, &finished);
+    }
+    if (done)
+        *done = finished;
+    if (len)
+        *len = finished ? 0 : gen->ref_len;
+    return finished ? NULL : gen->ref_ptr;
+}
+
+typedef struct {
+    int64_t* out;
+    size_t cap;
+    size_t count;
+} generator_batch_t;
+
+// Consumer that fills a batch and stops the generator once it is full
+static bool generator_batch_consume(int64_t value, void* ctx)
+{
+    generator_batch_t* batch = (generator_batch_t*)ctx;
+    batch->out[batch->count++] = value;
+    return batch->count < batch->cap;
+}
+
+/**
+ * @brief Gets up to cap values from the generator in a single resume.
+ *        While a batch is being filled, yield() stores into out and keeps
+ *        running the generator; it only switches back once out is full or
+ *        the generator function returns.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param out Buffer receiving the yielded values.
+ * @param cap Capacity of out, in values.
+ * @param done Output parameter. Set to true if the generator has finished;
+ * the values returned by this call are still valid in that case.
+ * @return The number of values stored in out.
+ */
+static inline size_t generator_next_batch(generator_t* gen, int64_t* out,
+    size_t cap, bool* done)
+{
+    if (!gen || generator_spent(gen)) {
+        if (done)
+            *done = true;
+        return 0;
+    }
+    if (!out || cap == 0) {
+        if (done)
+            *done = false;
+        return 0;
+    }
+
+    if (gen->pull) {
+        size_t count = 0;
+        while (count < cap && !generator_spent(gen)) {
+            generator_pull_next(gen);
+            if (gen->state != GEN_FINISHED) {
+                out[count++] = gen->yielded_value;
+            }
+        }
+        if (done)
+            *done = generator_spent(gen);
+        return count;
+    }
+
+    generator_batch_t batch = { out, cap, 0 };
+    gen->consumer = generator_batch_consume;
+    gen->consumer_ctx = &batch;
+    gen->sent_value = 0;
+    bool ok = generator_step(gen);
+    gen->consumer = NULL;
+
+    if (done) {
+        *done = !ok || generator_spent(gen); // The batch holds the last value taken
+    }
+    return batch.count;
+}
+
+/**
+ * @brief Runs the generator in push mode: each yield() calls func directly on
+ *        the generator's stack instead of switching back, so a full scan
+ *        costs one switch in and one out. The generator function is the same
+ *        one used with generator_next. If func returns false the generator
+ *        is suspended after that value and can be resumed again later.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param func Called with every value; returns false to stop.
+ * @param ctx Passed to func.
+ * @return true if the generator has finished, false if func stopped it.
+ */
+static inline bool generator_for_each(generator_t* gen,
+    generator_consume_func_t func, void* ctx)
+{
+    if (!gen || generator_spent(gen)) {
+        return true;
+    }
+    if (!func) {
+        return false;
+    }
+
+    if (gen->pull) {
+        for (;;) {
+            generator_pull_next(gen);
+            if (gen->state == GEN_FINISHED) {
+                return true;
+            }
+            bool more = func(gen->yielded_value, ctx);
+            if (generator_spent(gen)) {
+                return true;
+            }
+            if (!more) {
+                return false;
+            }
+        }
+    }
+
+    gen->consumer = func;
+    gen->consumer_ctx = ctx;
+    gen->sent_value = 0;
+    bool ok = generator_step(gen);
+    gen->consumer = NULL;
+    return !ok || generator_spent(gen);
+}
+
+// Shared body of yield() and yield_ref(): ref is published only once the
+// stages have accepted the value, so a dropped reference never reaches the
+// consumer and a plain yield never reports a stale one
+static int64_t generator_yield_ref(generator_t* self, int64_t value,
+    const void* ref_ptr, size_t ref_len)
+{
+    if (!self || self->state != GEN_RUNNING) {
+        fprintf(stderr, "Error: yield() called outside of a running generator "
+                        "context or with invalid generator.\n");
+        return 0;
+    }
+
+    if (self->closing) {
+        generator_abandon(self); // Yielded again instead of returning
+        return 0;
+    }
+
+    // After a transfer the value goes to the caller of the chain's origin.
+    // Inside yield_from, the stages of each generator of the delegation
+    // chain apply in turn, the delegate's own first.
+    generator_t* origin = self->origin;
+    bool exhausted = false;
+    for (generator_t* g = origin; g; g = g->delegator) {
+        generator_stages_t* stages = g->stages;
+        if (stages && !generator_apply_stages(stages, &value)) {
+            if (!stages->exhausted) {
+                return 0; // Filtered out: keep running without switching
+            }
+            generator_abandon(self); // Nothing more will be taken
+            return 0;
+        }
+        exhausted = exhausted || (stages && stages->exhausted);
+    }
+
+    origin->yielded_value = value;
+    origin->ref_ptr = ref_ptr;
+    origin->ref_len = ref_len;
+    if (origin->consumer) {
+        if (!origin->consumer(value, origin->consumer_ctx)) {
+            origin->consumer = NULL; // Tells generator_step to stop
+        } else if (!exhausted) {
+            return 0; // Push or batch mode: keep running on this stack
+        }
+    }
+
+    self->state = GEN_SUSPENDED;
+#if defined(GENERATOR_SHARED_STACK) && !defined(GENERATOR_ASM_SWITCH)
+    char marker;
+    self->saved_sp = (char*)((uintptr_t)&marker - GENERATOR_SHARED_STACK_SLACK);
+#endif
+
+    if (generator_context_switch(&self->context, &origin->caller_context) == -1) {
+        perror("swapcontext (yield -> caller) failed");
+        self->state = GEN_FINISHED;
+    }
+    return self->sent_value;
+}
+
+/**
+ * @brief Called from within the generator function to suspend the generator and
+ * return a value to the caller.
+ *        **Note: This function should only be called by the user-provided
+ * generator function.**
+ *
+ * @param self Pointer to the currently executing generator object (received by
+ * the generator function).
+ * @param value The value to yield.
+ * @return The value passed to the generator_send() that resumed the generator
+ * (0 for generator_next, while filling a batch and in generator_for_each).
+ */
+static inline int64_t yield(generator_t* self, int64_t value)
+{
+    return generator_yield_ref(self, value, NULL, 0);
+}
+
+/**
+ * @brief Called from within the generator function to yield a reference to
+ * len bytes at ptr without copying them. The consumer reads them through
+ * generator_next_ref(); generator_next() and the combinators see len as the
+ * value. ptr may point into the generator's stack: the memory only has to
+ * stay valid and unchanged until the generator is resumed.
+ *        **Note: This function should only be called by the user-provided
+ * generator function.**
+ *
+ * @param self Pointer to the currently executing generator object.
+ * @param ptr Memory to hand out.
+ * @param len Length of the memory in bytes.
+ * @return As for yield().
+ */
+static inline int64_t yield_ref(generator_t* self, const void* ptr, size_t len)
+{
+    return generator_yield_ref(self, (int64_t)len, ptr, len);
+}
+
+// Yields n elements of array by reference; the consumer gets the length in
+// bytes from generator_next_ref
+#define yield_span(self, array, n) \
+    yield_ref((self), (array), (size_t)(n) * sizeof(*(array)))
+
+/**
+ * @brief Called from within the generator function to yield every value of
+ * sub until it finishes. Instead of relaying each value, self links sub into
+ * a delegation chain: generator_next on the outermost generator resumes the
+ * innermost delegate directly, so a value costs one switch however deeply
+ * yield_from calls are nested. sub's own combinator stages apply to its
+ * values before those of self. Returns once sub has finished or reached a
+ * generator_take limit of its own.
+ *        **Note: This function should only be called by the user-provided
+ * generator function.** sub must not be resumed by anyone else meanwhile, and
+ * the caller still owns (and destroys) it afterwards.
+ *
+ * @param self Pointer to the currently executing generator object.
+ * @param sub The generator to delegate to.
+ */
+static inline void yield_from(generator_t* self, generator_t* sub)
+{
+    if (!self || self->state != GEN_RUNNING) {
+        fprintf(stderr, "Error: yield_from() called outside of a running "
+                        "generator context or with invalid generator.\n");
+        return;
+    }
+    if (!sub || sub == self || sub->state == GEN_RUNNING || sub->delegator
+        || sub->pull) {
+        fprintf(stderr, "Error: yield_from() needs a suspended generator (not a "
+                        "zip or chain) that is not already being delegated to.\n");
+        return;
+    }
+    if (self->origin != self) {
+        fprintf(stderr, "Error: yield_from() cannot be used by a generator "
+                        "reached through generator_transfer().\n");
+        return;
+    }
+    if (generator_spent(sub) || self->closing) {
+        return;
+    }
+
+    // Only the outermost generator is resumed by generator_next, so that is
+    // where the innermost delegate is recorded
+    generator_t* root = self;
+    while (root->delegator) {
+        root = root->delegator;
+    }
+    sub->delegator = self;
+    root->delegate = sub;
+
+    self->delegated = true;
+    self->state = GEN_SUSPENDED;
+#if defined(GENERATOR_SHARED_STACK) && !defined(GENERATOR_ASM_SWITCH)
+    char marker;
+    self->saved_sp = (char*)((uintptr_t)&marker - GENERATOR_SHARED_STACK_SLACK);
+#endif
+
+    // Resumed by generator_step once sub has finished
+    if (generator_context_switch(&self->context, &self->caller_context) == -1) {
+        perror("swapcontext (yield_from -> caller) failed");
+        self->state = GEN_FINISHED;
+    }
+}
+
+/**
+ * @brief Called from within the generator function of from to switch
+ * directly to the generator to, without going through the caller of
+ * generator_next. to receives value as the return value of the yield() or
+ * generator_transfer() it is suspended in (or as self->sent_value if it has
+ * not started). When to yields, the value goes to the caller that resumed the
+ * chain, and its next generator_next resumes that same generator (the
+ * chain's origin). When to returns, the origin is finished too.
+ * A pipeline of N stages that hands each item on with generator_transfer
+ * costs N + 1 switches per item instead of the 2N of nested generator_next.
+ *        **Note: This function should only be called by the user-provided
+ * generator function of from.** Not available with GENERATOR_SHARED_STACK.
+ * to must not be part of a yield_from chain, and from must not be closing.
+ * generator_close on the origin only closes the origin: close every stage of
+ * a transfer chain on its own.
+ *
+ * @param from Pointer to the currently executing generator object.
+ * @param to A suspended generator to continue.
+ * @param value The value to hand to to.
+ * @return The value sent to from by whichever generator_transfer() or
+ * generator_send() resumes it later, or 0 on error.
+ */
+static inline int64_t generator_transfer(generator_t* from, generator_t* to,
+    int64_t value)
+{
+    if (!from || from->state != GEN_RUNNING) {
+        fprintf(stderr, "Error: generator_transfer() called outside of a "
+                        "running generator context or with invalid generator.\n");
+        return 0;
+    }
+    if (to && to->state == GEN_HIBERNATED && !generator_rehydrate(to)) {
+        return 0;
+    }
+    if (!to || to == from || to->state != GEN_SUSPENDED || to->pull
+        || generator_spent(to) || to->delegate || to->delegator) {
+        fprintf(stderr, "Error: generator_transfer() needs a suspended, unfinished "
+                        "target generator (not a zip or chain) that is not in a "
+                        "yield_from chain.\n");
+        return 0;
+    }
+    if (from->closing) {
+        fprintf(stderr, "Error: generator_transfer() cannot be used by a "
+                        "generator that is being closed.\n");
+        return 0;
+    }
+#ifdef GENERATOR_SHARED_STACK
+    (void)value;
+    fprintf(stderr, "Error: generator_transfer() is not supported with "
+                    "GENERATOR_SHARED_STACK.\n");
+    return 0;
+#else
+#ifdef GENERATOR_LAZY_STACK
+    if (!to->stack && !generator_lazy_stack(to)) {
+        return 0;
+    }
+#endif
+    to->origin = from->origin;
+    to->sent_value = value;
+    from->state = GEN_SUSPENDED;
+    to->state = GEN_RUNNING;
+
+    if (generator_context_switch(&from->context, &to->context) == -1) {
+        perror("swapcontext (generator -> generator) failed");
+        from->state = GEN_RUNNING;
+        to->state = GEN_SUSPENDED;
+        return 0;
+    }
+    return from->sent_value;
+#endif
+}
+
+/**
+ * @brief Called from within the generator function to check whether it was
+ * resumed by generator_close(). If so it should release what it holds and
+ * return instead of yielding again.
+ *
+ * @param self Pointer to the currently executing generator object.
+ * @return true while the generator is being closed.
+ */
+static inline bool generator_is_closing(const generator_t* self)
+{
+    return self && self->closing;
+}
+
+/**
+ * @brief Finishes a suspended generator early, letting it clean up first.
+ * The yield() it is suspended in returns 0 with generator_is_closing(self)
+ * true, and the generator then runs until its function returns, so it can
+ * release buffers, descriptors and the like. Generators it is delegating to
+ * with yield_from are closed first, innermost first; a zip or chain closes
+ * its inputs. A generator that yields again while closing is abandoned at
+ * that yield, as by generator_destroy. A generator stopped at a
+ * generator_take limit is still suspended and is closed the same way; one
+ * that never started is only marked finished. The generator must still be
+ * destroyed.
+ *
+ * @param gen Pointer to a generator that is not running.
+ */
+static inline void generator_close(generator_t* gen)
+{
+    if (!gen || gen->state == GEN_FINISHED) {
+        return;
+    }
+    if (gen->state == GEN_RUNNING) {
+        fprintf(stderr, "Error: generator_close() cannot close a running "
+                        "generator.\n");
+        return;
+    }
+    if (gen->pull) {
+        generator_combinator_t* comb = (generator_combinator_t*)gen->user_data;
+        generator_close(comb->inputs[0]);
+        generator_close(comb->inputs[1]);
+    } else if (gen->origin) {
+        // Values yielded while closing go nowhere
+        generator_stages_t* stages = gen->stages;
+        gen->stages = NULL;
+        gen->consumer = NULL;
+        gen->sent_value = 0;
+        gen->closing = true;
+        generator_step(gen);
+        gen->closing = false;
+        gen->stages = stages;
+    }
+    gen->state = GEN_FINISHED;
+}
+
+// Releases gen and everything it owns
+static void generator_free(generator_t* gen)
+{
+    if (gen) {
+        if (gen->pull) {
+            generator_combinator_t* comb = (generator_combinator_t*)gen->user_data;
+            generator_destroy(comb->inputs[0]);
+            generator_destroy(comb->inputs[1]);
+            free(comb);
+        }
+        free(gen->stages);
+        if (gen->state == GEN_HIBERNATED) {
+            free(*generator_hibernation_slot(gen));
+        }
+#ifdef GENERATOR_SHARED_STACK
+        if (generator_shared.occupant == gen) {
+            generator_shared.occupant = NULL;
+        }
+        free(gen->saved_stack); // The stack itself belongs to the thread
+#endif
+        if (gen->borrowed) {
+            return; // Memory from generator_init stays with the caller
+        }
+#ifdef GENERATOR_COMPACT
+        if (!gen->pull) {
+            // The control block goes with its stack
+            generator_stack_free(generator_stack_base(gen), gen->stack_size);
+            return;
+        }
+#elif !defined(GENERATOR_SHARED_STACK)
+        if (gen->stack) {
+            generator_stack_free(gen->stack, gen->stack_size);
+        }
+#endif
+        free(gen);
+    }
+}
+
+/**
+ * @brief Destroys the generator and releases its resources (including the
+ * stack). With GENERATOR_FREE_LIST it may instead be kept, stack and all, for
+ * reuse by generator_create.
+ *
+ * @param gen Pointer to the generator to destroy.
+ */
+static void generator_destroy(generator_t* gen)
+{
+#ifdef GENERATOR_STACK_STATS
+    if (gen && !gen->pull) {
+        generator_stack_record(gen);
+    }
+#endif
+#ifdef GENERATOR_FREE_LIST
+    generator_free_list_t* list = NULL;
+    if (gen && !gen->pull && !gen->borrowed
+#ifdef GENERATOR_LAZY_STACK
+        && gen->stack // Never resumed: nothing warm to keep
+#endif
+    ) {
+        list = generator_free_list(gen->user_func, true);
+    }
+    if (list && list->count < GENERATOR_FREE_LIST_SIZE) {
+        free(gen->stages);
+        gen->stages = NULL;
+        if (gen->state == GEN_HIBERNATED) {
+            free(*generator_hibernation_slot(gen));
+        }
+#ifdef GENERATOR_SHARED_STACK
+        if (generator_shared.occupant == gen) {
+            generator_shared.occupant = NULL;
+        }
+#endif
+        gen->state = GEN_FINISHED; // Its frames are abandoned
+        generator_free_list_register_thread();
+        list->gens[list->count++] = gen;
+        return;
+    }
+#endif
+    generator_free(gen);
+}
+
+/**
+ * @brief Restarts a generator with a new function and user data, reusing its
+ * control block and stack. Whatever the previous run left on the stack is
+ * abandoned without being unwound, as in generator_destroy.
+ *
+ * @param gen Pointer to a generator that is not running.
+ * @param func The user-provided generator function.
+ * @param user_data Optional user data to pass to the generator function.
+ * @return true on success. On failure gen is left finished and must still be
+ * destroyed.
+ */
+static inline bool generator_reset(generator_t* gen, generator_func_t func,
+    void* user_data)
+{
+    if (!gen || !func || gen->pull || gen->state == GEN_RUNNING) {
+        fprintf(stderr, "Error: generator_reset() needs a generator (not a zip "
+                        "or chain) that is not running and a function.\n");
+        return false;
+    }
+
+    free(gen->stages);
+    gen->stages = NULL;
+    if (gen->state == GEN_HIBERNATED) {
+        free(*generator_hibernation_slot(gen));
+    }
+#ifdef GENERATOR_SHARED_STACK
+    if (generator_shared.occupant == gen) {
+        generator_shared.occupant = NULL; // Its frames are dead
+    }
+#endif
+#ifdef GENERATOR_STACK_STATS
+    generator_stack_record(gen);
+#endif
+    return generator_prepare(gen, func, user_data);
+}
+
+#ifdef GENERATOR_FREE_LIST
+/**
+ * @brief Frees the generators kept on the calling thread's free lists. This
+ * happens anyway when a thread exits; call it to release them earlier.
+ */
+static inline void generator_free_list_flush(void)
+{
+    generator_free_list_release(generator_free_lists);
+}
+#endif
+
+#ifdef GENERATOR_STACK_STATS
+
+typedef struct {
+    size_t count; // Runs measured
+    size_t mean_peak; // Average peak stack usage, bytes
+    size_t max_peak; // Largest peak stack usage, bytes
+} generator_stack_stats_t;
+
+/**
+ * @brief Measures how much of its stack gen has used so far: the distance
+ * from the top of the stack to the deepest byte written since it was set up.
+ *
+ * @param gen Pointer to a generator that is not running.
+ * @return The peak stack usage in bytes, 0 if gen has no stack yet.
+ */
+static inline size_t generator_stack_peak(generator_t* gen)
+{
+    if (!gen || gen->pull || !gen->origin || gen->state == GEN_HIBERNATED) {
+        return 0;
+    }
+    return generator_stack_measure(gen);
+}
+
+/**
+ * @brief Gets the stack statistics of the finished runs of func, collected
+ * by generator_destroy and generator_reset on all threads.
+ *
+ * @param func The generator function.
+ * @param stats Output parameter.
+ * @return false if no run of func has been measured.
+ */
+static inline bool generator_stack_stats(generator_func_t func,
+    generator_stack_stats_t* stats)
+{
+    generator_stack_stats_slot_t* slot = generator_stack_stats_slot(func, false);
+    size_t count = slot ? atomic_load(&slot->count) : 0;
+    if (count == 0 || !stats) {
+        return false;
+    }
+    stats->count = count;
+    stats->mean_peak = atomic_load(&slot->total_peak) / count;
+    stats->max_peak = atomic_load(&slot->max_peak);
+    return true;
+}
+
+/**
+ * @brief Prints the stack statistics of every measured generator function.
+ *
+ * @param out Stream to print to, for example stderr.
+ */
+static inline void generator_stack_stats_print(FILE* out)
+{
+    fprintf(out, "%-18s %10s %10s %10s\n", "function", "runs", "mean peak", "max peak");
+    for (size_t i = 0; i < GENERATOR_STACK_STATS_FUNCS; ++i) {
+        generator_func_t func = atomic_load(&generator_stack_stats_table[i].func);
+        generator_stack_stats_t stats;
+        if (func && generator_stack_stats(func, &stats)) {
+            fprintf(out, "%-18p %10zu %10zu %10zu\n", (void*)(uintptr_t)func,
+                stats.count, stats.mean_peak, stats.max_peak);
+        }
+    }
+}
+
+#endif // GENERATOR_STACK_STATS
+
+// --- Stack Trimming ---
+#ifdef GENERATOR_HAVE_MADVISE
+
+/**
+ * @brief Releases the pages of a generator's stack that it is not using
+ * right now: everything below its stack pointer while it is suspended, the
+ * whole stack once it has finished. Pages a generator dirtied in a deep call
+ * and then returned from stay resident otherwise. The memory stays mapped
+ * and reads as zeros (with the default GENERATOR_TRIM_ADVICE, MADV_DONTNEED)
+ * when the generator grows into it again. With MADV_FREE the kernel only
+ * takes the pages back under memory pressure.
+ *        Call it on the thread that owns the generator, not concurrently with
+ * a resume. Trimmed pages count as used for GENERATOR_STACK_STATS. Nothing
+ * is trimmed with GENERATOR_SHARED_STACK, or with the ucontext backend on
+ * platforms other than x86-64 glibc. Only declared where <sys/mman.h>
+ * provides madvise (with glibc, not in strict -std=c11 mode unless
+ * _DEFAULT_SOURCE is defined).
+ *
+ * @param gen Pointer to a generator that is not running.
+ * @return The number of bytes that were resident and have been released.
+ */
+static inline size_t generator_trim(generator_t* gen)
+{
+#ifdef GENERATOR_SHARED_STACK
+    (void)gen;
+    return 0;
+#else
+    if (!gen || gen->pull || gen->state == GEN_RUNNING
+        || gen->state == GEN_HIBERNATED || !generator_stack_base(gen)) {
+        return 0;
+    }
+    size_t page = generator_page_size();
+    char* base = (char*)generator_stack_base(gen);
+    char* end = base + generator_stack_usable(gen);
+    if (gen->state == GEN_SUSPENDED) {
+        end = generator_suspended_sp(gen);
+        if (!end) {
+            return 0;
+        }
+        end -= 128; // Keep the red zone below the stack pointer
+    }
+    char* start = (char*)(((uintptr_t)base + page - 1) & ~(uintptr_t)(page - 1));
+    end = (char*)((uintptr_t)end & ~(uintptr_t)(page - 1));
+    if (end <= start) {
+        return 0;
+    }
+
+    // Count what is resident first, 64 pages at a time
+    size_t released = 0;
+    unsigned char resident[64];
+    for (char* chunk = start; chunk < end; chunk += 64 * page) {
+        size_t len = ((size_t)(end - chunk) < 64 * page) ? (size_t)(end - chunk) : 64 * page;
+        if (mincore(chunk, len, resident) == 0) {
+            for (size_t i = 0; i < len / page; ++i) {
+                released += (resident[i] & 1) ? page : 0;
+            }
+        }
+    }
+    if (madvise(start, (size_t)(end - start), GENERATOR_TRIM_ADVICE) == -1) {
+        perror("madvise for generator stack failed");
+        return 0;
+    }
+    return released;
+#endif
+}
+
+/**
+ * @brief Hibernates a suspended generator: the live part of its stack is
+ * compressed into a right-sized heap buffer and the whole stack is released
+ * as by generator_trim. The next resume (generator_next and friends,
+ * yield_from, generator_transfer, generator_close) decompresses it back in
+ * place first, so hibernation is invisible to the generator. References
+ * handed out with yield_ref into its stack become invalid.
+ *        Call it on the thread that owns the generator. Partial pages at the
+ * ends of a malloc'd stack and, with GENERATOR_COMPACT, the page holding the
+ * control block stay resident; GENERATOR_MMAP_STACK stacks are released
+ * entirely. Not available with GENERATOR_SHARED_STACK, or with the ucontext
+ * backend on platforms other than x86-64 glibc. Declared only where
+ * generator_trim is.
+ *
+ * @param gen Pointer to a suspended generator that has started.
+ * @return The bytes held by the compressed image, or 0 if gen was not
+ * hibernated.
+ */
+static inline size_t generator_hibernate(generator_t* gen)
+{
+#ifdef GENERATOR_SHARED_STACK
+    (void)gen;
+    return 0;
+#else
+    if (!gen || gen->pull || gen->state != GEN_SUSPENDED || !gen->origin
+        || !generator_stack_base(gen) || !generator_suspended_sp(gen)) {
+        return 0;
+    }
+    char* base = (char*)generator_stack_base(gen);
+    char* top = base + generator_stack_usable(gen);
+    char* low = generator_suspended_sp(gen) - 128; // With the red zone
+    if (low < base) {
+        low = base;
+    }
+    size_t live = (size_t)(top - low);
+
+    generator_hibernation_t* image = (generator_hibernation_t*)malloc(
+        sizeof(generator_hibernation_t) + live);
+    if (!image) {
+        perror("malloc for generator hibernation failed");
+        return 0;
+    }
+    image->live = live;
+    image->packed = generator_lz_compress(low, live, image->data, live - 1);
+    if (image->packed == 0) {
+        memcpy(image->data, low, live); // Incompressible: keep it as is
+        image->packed = live;
+    } else {
+        generator_hibernation_t* shrunk = (generator_hibernation_t*)realloc(
+            image, sizeof(generator_hibernation_t) + image->packed);
+        image = shrunk ? shrunk : image;
+    }
+
+    // The compact slot lives at the top of the stack: keep its page
+    char* keep = (char*)generator_hibernation_slot(gen);
+    if (keep < base || keep > top) {
+        keep = top;
+    }
+    size_t page = generator_page_size();
+    char* start = (char*)(((uintptr_t)base + page - 1) & ~(uintptr_t)(page - 1));
+    char* end = (char*)((uintptr_t)keep & ~(uintptr_t)(page - 1));
+    if (end > start && madvise(start, (size_t)(end - start), GENERATOR_TRIM_ADVICE) == -1) {
+        perror("madvise for generator stack failed"); // The image is still valid
+    }
+
+    *generator_hibernation_slot(gen) = image;
+    gen->state = GEN_HIBERNATED;
+    return sizeof(generator_hibernation_t) + image->packed;
+#endif
+}
+
+#endif // GENERATOR_HAVE_MADVISE
+
+// --- Combinators ---
+// Combinators take ownership of the generators passed in: use (and destroy)
+// only the generator they return, which is NULL if they failed. map, filter,
+// take and enumerate are fused into gen itself and run inside yield() on the
+// generator's stack, so a filter->map->take chain still costs one switch per
+// delivered value and none per dropped one. zip and chain return generators
+// without a stack that pull from their inputs directly.
+
+// Appends a stage to gen, destroying gen if that fails
+static generator_t* generator_add_stage(generator_t* gen, generator_stage_t stage)
+{
+    if (!gen) {
+        return NULL;
+    }
+
+    generator_stages_t* stages = gen->stages;
+    if (!stages || stages->count == stages->capacity) {
+        size_t capacity = stages ? stages->capacity * 2 : 4;
+        generator_stages_t* grown = (generator_stages_t*)realloc(stages,
+            sizeof(generator_stages_t) + capacity * sizeof(generator_stage_t));
+        if (!grown) {
+            perror("realloc for generator stages failed");
+            generator_destroy(gen);
+            return NULL;
+        }
+        if (!stages) {
+            grown->count = 0;
+            grown->exhausted = false;
+        }
+        grown->capacity = capacity;
+        gen->stages = stages = grown;
+    }
+
+    stages->stage[stages->count++] = stage;
+    if (stage.kind == GEN_STAGE_TAKE && stage.count == 0) {
+        stages->exhausted = true;
+    }
+    return gen;
+}
+
+/**
+ * @brief Replaces every value of gen by func(value, ctx).
+ *
+ * @param gen The generator to transform (consumed).
+ * @param func Mapping function.
+ * @param ctx Passed to func.
+ * @return gen, or NULL on failure (gen is destroyed).
+ */
+static inline generator_t* generator_map(generator_t* gen,
+    generator_map_func_t func, void* ctx)
+{
+    generator_stage_t stage = { GEN_STAGE_MAP, { .map = func }, ctx, 0 };
+    return func ? generator_add_stage(gen, stage) : gen;
+}
+
+/**
+ * @brief Drops the values of gen for which func(value, ctx) is false. Dropped
+ * values never leave the generator's context.
+ *
+ * @param gen The generator to filter (consumed).
+ * @param func Predicate.
+ * @param ctx Passed to func.
+ * @return gen, or NULL on failure (gen is destroyed).
+ */
+static inline generator_t* generator_filter(generator_t* gen,
+    generator_filter_func_t func, void* ctx)
+{
+    generator_stage_t stage = { GEN_STAGE_FILTER, { .filter = func }, ctx, 0 };
+    return func ? generator_add_stage(gen, stage) : gen;
+}
+
+/**
+ * @brief Stops gen after count values. Once the limit is reached the generator
+ * reports done without being resumed again; it stays suspended in its yield,
+ * and generator_close lets it clean up.
+ *
+ * @param gen The generator to limit (consumed).
+ * @param count Maximum number of values.
+ * @return gen, or NULL on failure (gen is destroyed).
+ */
+static inline generator_t* generator_take(generator_t* gen, uint64_t count)
+{
+    generator_stage_t stage = { GEN_STAGE_TAKE, { .map = NULL }, NULL, count };
+    return generator_add_stage(gen, stage);
+}
+
+/**
+ * @brief Replaces the i-th value of gen (counting from 0) by
+ * func(i, value, ctx).
+ *
+ * @param gen The generator to number (consumed).
+ * @param func Combines the index and the value.
+ * @param ctx Passed to func.
+ * @return gen, or NULL on failure (gen is destroyed).
+ */
+static inline generator_t* generator_enumerate(generator_t* gen,
+    generator_combine_func_t func, void* ctx)
+{
+    generator_stage_t stage = { GEN_STAGE_ENUMERATE, { .combine = func }, ctx, 0 };
+    return func ? generator_add_stage(gen, stage) : gen;
+}
+
+static bool generator_zip_pull(generator_t* gen, int64_t* value)
+{
+    generator_combinator_t* comb = (generator_combinator_t*)gen->user_data;
+    bool done_a = false, done_b = false;
+    int64_t a = generator_next(comb->inputs[0], &done_a);
+    if (done_a) {
+        return false;
+    }
+    int64_t b = generator_next(comb->inputs[1], &done_b);
+    if (done_b) {
+        return false;
+    }
+    *value = comb->combine(a, b, comb->ctx);
+    return true;
+}
+
+static bool generator_chain_pull(generator_t* gen, int64_t* value)
+{
+    generator_combinator_t* comb = (generator_combinator_t*)gen->user_data;
+    while (comb->current < 2) {
+        bool finished = false;
+        int64_t next = generator_next(comb->inputs[comb->current], &finished);
+        if (!finished) {
+            *value = next;
+            return true;
+        }
+        comb->current++;
+    }
+    return false;
+}
+
+static generator_t* generator_create_combinator(
+    bool (*pull)(generator_t* gen, int64_t* value), generator_t* a,
+    generator_t* b, generator_combine_func_t combine, void* ctx)
+{
+    generator_t* gen = NULL;
+    generator_combinator_t* comb = NULL;
+    if (a && b) {
+        gen = (generator_t*)calloc(1, sizeof(generator_t));
+        comb = (generator_combinator_t*)malloc(sizeof(generator_combinator_t));
+    }
+    if (!gen || !comb) {
+        if (a && b) {
+            perror("malloc for generator combinator failed");
+        }
+        free(gen);
+        free(comb);
+        generator_destroy(a);
+        generator_destroy(b);
+        return NULL;
+    }
+
+    comb->inputs[0] = a;
+    comb->inputs[1] = b;
+    comb->current = 0;
+    comb->combine = combine;
+    comb->ctx = ctx;
+
+    gen->state = GEN_SUSPENDED;
+    gen->user_data = comb;
+    gen->origin = gen;
+    gen->pull = pull;
+    return gen;
+}
+
+/**
+ * @brief Pairs up the values of a and b: the i-th value is
+ * func(a_i, b_i, ctx). Ends as soon as either input ends.
+ *
+ * @param a First input (consumed).
+ * @param b Second input (consumed).
+ * @param func Combines a pair of values.
+ * @param ctx Passed to func.
+ * @return A new generator, or NULL on failure (a and b are destroyed).
+ */
+static inline generator_t* generator_zip(generator_t* a, generator_t* b,
+    generator_combine_func_t func, void* ctx)
+{
+    if (!func) {
+        fprintf(stderr, "Error: generator_zip() needs a combine function.\n");
+        generator_destroy(a);
+        generator_destroy(b);
+        return NULL;
+    }
+    return generator_create_combinator(generator_zip_pull, a, b, func, ctx);
+}
+
+/**
+ * @brief Yields all values of a, then all values of b.
+ *
+ * @param a First input (consumed).
+ * @param b Second input (consumed).
+ * @return A new generator, or NULL on failure (a and b are destroyed).
+ */
+static inline generator_t* generator_chain(generator_t* a, generator_t* b)
+{
+    return generator_create_combinator(generator_chain_pull, a, b, NULL, NULL);
 }
 
 #endif // GENERATOR_H
@@ -2,11 +2,42 @@
 #define GENERATOR_PTHREAD_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h> // For int64_t
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h> // For error checking
+#include <setjmp.h> // For unwinding destroyed generators off a pool thread
+#include <unistd.h> // For sysconf
+// syscall() is only declared with _DEFAULT_SOURCE/_GNU_SOURCE (which the C
+// library defines unless a strict mode such as -std=c11 is requested)
+#if defined(__linux__) \
+    && (defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE) || defined(_BSD_SOURCE))
+#define GENERATOR_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#else
+#include <sched.h> // No futex: parked threads fall back to sched_yield
+#endif
+
+// --- Constants ---
+// Iterations a waiting thread spins (with a pause hint) before parking on a
+// futex. Only used on multi-core machines; with a single CPU the other side
+// cannot make progress while we spin. Set per generator with
+// generator_set_spin_budget(); GENERATOR_SPIN_FOREVER never parks, for
+// busy-polling deployments.
+#ifndef GENERATOR_SPIN_BUDGET
+#define GENERATOR_SPIN_BUDGET 100
+#endif
+#define GENERATOR_SPIN_FOREVER UINT32_MAX
+// Thread pool defaults, see generator_thread_pool_configure()
+#ifndef GENERATOR_THREAD_POOL_MAX
+#define GENERATOR_THREAD_POOL_MAX 16 // Idle threads kept for reuse
+#endif
+#ifndef GENERATOR_THREAD_STACK_SIZE
+#define GENERATOR_THREAD_STACK_SIZE 0 // 0: the system default thread stack
+#endif
 
 // --- Opaque Generator Type ---
 typedef struct generator generator_t;
@@ -15,6 +46,9 @@ typedef struct generator generator_t;
 // User function receives the generator object pointer
 typedef void (*generator_func_t)(generator_t* self);
 
+// Consumer for generator_for_each: return true to continue, false to stop
+typedef bool (*generator_consume_func_t)(int64_t value, void* ctx);
+
 
 
 
@@ -28,78 +62,397 @@ typedef enum {
     GEN_FINISHED    // Generator thread function has returned
 } generator_state_t;
 
+// Values of the handoff word: whose turn it is to run, plus a flag set by a
+// thread that parked on the futex so the other side knows to wake it.
+#define GEN_TURN_CALLER 0u
+#define GEN_TURN_GENERATOR 1u
+#define GEN_TURN_PARKED 2u
+
+// Values of generator_t.closing
+#define GEN_CLOSE_NONE 0u
+#define GEN_CLOSE_REQUESTED 1u  // generator_close was called
+#define GEN_CLOSE_SEEN 2u       // A yield has returned since; the next one abandons
+
+// A pooled thread. It is bound to a generator on that generator's first
+// generator_next and returns to the pool once the generator function
+// returns or the generator is destroyed.
+typedef struct generator_worker {
+    pthread_t thread;
+    atomic_uint assigned;       // 0 idle, 1 gen is set, 2 exit (futex word)
+    generator_t* gen;           // Generator to run, written before assigned
+    jmp_buf unwind;             // yield() jumps here when its generator is destroyed
+    struct generator_worker* next; // Idle list link
+} generator_worker_t;
+
 struct generator {
-    pthread_t thread_id;        // Generator thread identifier
-    pthread_mutex_t mtx;        // Mutex for protecting shared data
-    pthread_cond_t cond_yield;  // Signaled by caller (next) to wake generator (yield)
-    pthread_cond_t cond_next;   // Signaled by generator (yield/finish) to wake caller (next)
+    bool bound;                 // Has a pool thread (caller-side flag)
+    atomic_uint refs;           // Caller + bound worker; the last release frees
+    atomic_uint exited;         // 1 once the worker left user code, 2 if destroy waits
+    atomic_uint turn;           // Handoff word, see GEN_TURN_*
+    uint32_t spin_budget;       // Spins before parking, see GENERATOR_SPIN_BUDGET
 
     generator_func_t user_func; // User's generator function
     void* user_data;            // Data passed during creation
-    int64_t yielded_value;      // Value passed via yield()
-    generator_state_t state;    // Current state of the generator
-    bool value_ready;           // Flag: Is yielded_value fresh?
-    bool started;               // Flag: Has the generator thread started execution?
+    int64_t yielded_value;      // Value passed via yield(), published by the handoff
+    int64_t sent_value;         // Value passed via generator_send(), returned by yield()
+    const void* ref_ptr;        // Memory passed to yield_ref(), NULL after a plain yield()
+    size_t ref_len;             // Bytes at ref_ptr
+    _Atomic generator_state_t state; // Current state of the generator
+    atomic_uint closing;        // See GEN_CLOSE_*
+
+    // Batch mode: owned by the generator thread between the two handoffs
+    int64_t* batch_buf;         // Consumer buffer while in generator_next_batch
+    size_t batch_cap;           // Capacity of batch_buf
+    size_t batch_count;         // Values stored into batch_buf so far
+    generator_consume_func_t consumer; // Called by yield() in generator_for_each
+    void* consumer_ctx;
+
+    // Run-ahead mode (ring != NULL): the generator thread pushes into a
+    // bounded single-producer/single-consumer ring and only blocks when it
+    // is full; the consumer pops without locking while values are present.
+    int64_t* ring;              // Ring storage, ring_mask + 1 slots
+    size_t ring_mask;           // Capacity - 1 (capacity is a power of two)
+    atomic_size_t ring_head;    // Next slot to read, written by the consumer
+    atomic_size_t ring_tail;    // Next slot to write, written by the producer
+    atomic_uint consumer_waiting; // Consumer is (about to be) parked, futex word
+    atomic_uint producer_waiting; // Producer is (about to be) parked, futex word
+    atomic_bool ring_closed;    // Generator function returned, no more pushes
+    atomic_bool ring_stop;      // generator_destroy asked the producer to exit
+    bool ring_started;          // Consumer has started the thread (consumer-only)
+};
+
+// --- Futex Handoff Helpers ---
+
+static inline void generator_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// Blocks while *word == expected (or returns spuriously)
+static inline void generator_futex_wait(atomic_uint* word, uint32_t expected) {
+#ifdef GENERATOR_FUTEX
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    (void)word;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+static inline void generator_futex_wake(atomic_uint* word) {
+#ifdef GENERATOR_FUTEX
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+// Gives the turn to the other side, waking it if it parked. The release
+// publishes everything written before the handoff (yielded_value, state...).
+static inline void generator_handoff(generator_t* gen, uint32_t turn) {
+    if (atomic_exchange_explicit(&gen->turn, turn, memory_order_acq_rel) & GEN_TURN_PARKED) {
+        generator_futex_wake(&gen->turn);
+    }
+}
+
+// Waits until it is our turn: spin first, then park on the futex.
+static inline void generator_await(generator_t* gen, uint32_t turn) {
+    for (uint32_t i = 0; gen->spin_budget == GENERATOR_SPIN_FOREVER || i < gen->spin_budget; ++i) {
+        if ((atomic_load_explicit(&gen->turn, memory_order_acquire) & ~GEN_TURN_PARKED) == turn) {
+            return;
+        }
+        generator_cpu_relax();
+    }
+
+    for (;;) {
+        uint32_t cur = atomic_load_explicit(&gen->turn, memory_order_acquire);
+        if ((cur & ~GEN_TURN_PARKED) == turn) {
+            return;
+        }
+        if (!(cur & GEN_TURN_PARKED)) {
+            if (!atomic_compare_exchange_weak(&gen->turn, &cur, cur | GEN_TURN_PARKED)) {
+                continue; // Turn changed under us, re-check
+            }
+            cur |= GEN_TURN_PARKED;
+        }
+        generator_futex_wait(&gen->turn, cur);
+    }
+}
+
+// Parks on a ring wait flag until ready() holds. The flag is raised before
+// the final re-check, and the other side clears it and wakes us after
+// changing the ring, so a wake-up cannot be lost.
+static inline void generator_ring_park(generator_t* gen, atomic_uint* flag,
+                                       bool (*ready)(generator_t*, size_t), size_t pos) {
+    for (uint32_t i = 0; gen->spin_budget == GENERATOR_SPIN_FOREVER || i < gen->spin_budget; ++i) {
+        if (ready(gen, pos)) {
+            return;
+        }
+        generator_cpu_relax();
+    }
+    for (;;) {
+        atomic_store(flag, 1);
+        if (ready(gen, pos)) {
+            atomic_store(flag, 0);
+            return;
+        }
+        generator_futex_wait(flag, 1);
+    }
+}
+
+static inline void generator_ring_unpark(atomic_uint* flag) {
+    if (atomic_load(flag) && atomic_exchange(flag, 0)) {
+        generator_futex_wake(flag);
+    }
+}
+
+// --- Thread Pool ---
+
+static struct {
+    pthread_mutex_t mtx;        // Protects everything below
+    generator_worker_t* idle;   // Idle workers, parked on their assigned word
+    size_t idle_count;
+    size_t max_idle;            // Extra workers exit instead of going idle
+    size_t stack_size;          // For new workers, 0 for the system default
+} generator_thread_pool = {
+    PTHREAD_MUTEX_INITIALIZER, NULL, 0, GENERATOR_THREAD_POOL_MAX, GENERATOR_THREAD_STACK_SIZE
 };
 
+static __thread generator_worker_t* generator_current_worker;
+
+// Abandons the generator running on this worker (it was destroyed)
+static void generator_unwind(void) {
+    longjmp(generator_current_worker->unwind, 1);
+}
+
+static void generator_release(generator_t* gen) {
+    if (atomic_fetch_sub(&gen->refs, 1) == 1) {
+        free(gen->ring);
+        free(gen);
+    }
+}
+
+static uint32_t generator_default_spin_budget(void) {
+    static atomic_long cpus = 0; // Cached: creating threads race to fill it
+    long n = atomic_load_explicit(&cpus, memory_order_relaxed);
+    if (n == 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        atomic_store_explicit(&cpus, n, memory_order_relaxed);
+    }
+    return n > 1 ? GENERATOR_SPIN_BUDGET : 0;
+}
+
+// --- Run-Ahead Ring Helpers ---
+
+static bool generator_ring_has_space(generator_t* gen, size_t tail) {
+    return tail - atomic_load(&gen->ring_head) <= gen->ring_mask
+           || atomic_load(&gen->ring_stop) || atomic_load(&gen->closing);
+}
+
+static bool generator_ring_has_data(generator_t* gen, size_t head) {
+    return head != atomic_load(&gen->ring_tail) || atomic_load(&gen->ring_closed);
+}
+
+// Called from yield() in run-ahead mode. Blocks only while the ring is full.
+static void generator_ring_push(generator_t* self, int64_t value) {
+    size_t tail = atomic_load_explicit(&self->ring_tail, memory_order_relaxed);
+
+    if (tail - atomic_load_explicit(&self->ring_head, memory_order_acquire) > self->ring_mask) {
+        generator_ring_park(self, &self->producer_waiting, generator_ring_has_space, tail);
+    }
+    if (atomic_load_explicit(&self->ring_stop, memory_order_relaxed)) {
+        generator_unwind(); // Destroyed while running ahead
+    }
+    uint32_t closing = atomic_load(&self->closing);
+    if (closing == GEN_CLOSE_SEEN) {
+        generator_unwind(); // Yielded again instead of returning
+    }
+    if (closing == GEN_CLOSE_REQUESTED) {
+        atomic_store(&self->closing, GEN_CLOSE_SEEN); // Drop the value, let it clean up
+        return;
+    }
+
+    self->ring[tail & self->ring_mask] = value;
+    atomic_store(&self->ring_tail, tail + 1);
+    generator_ring_unpark(&self->consumer_waiting);
+}
 
-static void* generator_thread_entry(void* arg) {
-    generator_t* self = (generator_t*)arg;
 
+
+// Runs one generator to completion (or until it is destroyed) on the
+// calling worker thread.
+static void generator_run(generator_worker_t* worker, generator_t* self) {
     // --- Initial wait for the first 'next' call ---
-    pthread_mutex_lock(&self->mtx);
-    // Mark as started *before* waiting, so destroy knows if join is needed
-    self->started = true;
-    // Wait until the first generator_next signals us to start
-    while (self->state == GEN_SUSPENDED && self->started) { // Check started to handle immediate destroy
-         // printf("[Thread %p] Waiting for initial signal...\n", (void*)pthread_self());
-         pthread_cond_wait(&self->cond_yield, &self->mtx);
-         // printf("[Thread %p] Initial signal received.\n", (void*)pthread_self());
-         if (self->state == GEN_FINISHED) { // Check if destroyed before starting
-             pthread_mutex_unlock(&self->mtx);
-             return NULL;
-         }
-    }
-     // Set state to running *after* being signaled to start
-    if (self->state != GEN_FINISHED) { // Avoid race if destroyed quickly
-        self->state = GEN_RUNNING;
-    }
-    pthread_mutex_unlock(&self->mtx);
+    // printf("[Thread %p] Waiting for initial signal...\n", (void*)pthread_self());
+    generator_await(self, GEN_TURN_GENERATOR);
+    // printf("[Thread %p] Initial signal received.\n", (void*)pthread_self());
     // --- End Initial wait ---
 
 
     // --- Execute User Function ---
     // Only run if not already marked as finished (e.g., by destroy)
-    if (self->state == GEN_RUNNING) {
-        // printf("[Thread %p] Calling user function...\n", (void*)pthread_self());
-        self->user_func(self);
-        // printf("[Thread %p] User function returned.\n", (void*)pthread_self());
+    // (setjmp may not be an operand of &&, so the state check is nested)
+    if (setjmp(worker->unwind) == 0) {
+        if (self->state == GEN_RUNNING) {
+            // printf("[Thread %p] Calling user function...\n", (void*)pthread_self());
+            self->user_func(self);
+            // printf("[Thread %p] User function returned.\n", (void*)pthread_self());
+        }
     }
     // --- End User Function Execution ---
 
 
     // --- Finalization ---
-    pthread_mutex_lock(&self->mtx);
     self->state = GEN_FINISHED;
-    self->value_ready = true; // Signal completion
+    atomic_store(&self->ring_closed, true); // Run-ahead: nothing more to pop
+    generator_ring_unpark(&self->consumer_waiting);
     // printf("[Thread %p] Signaling FINISHED to caller.\n", (void*)pthread_self());
-    pthread_cond_signal(&self->cond_next); // Wake up the caller waiting in next()
-    pthread_mutex_unlock(&self->mtx);
+    generator_handoff(self, GEN_TURN_CALLER); // Wake up the caller waiting in next()
+    if (atomic_exchange(&self->exited, 1) == 2) {
+        generator_futex_wake(&self->exited); // generator_destroy is waiting
+    }
+    generator_release(self);
     // --- End Finalization ---
+}
+
+static void* generator_worker_main(void* arg) {
+    generator_worker_t* worker = (generator_worker_t*)arg;
+    generator_current_worker = worker;
+
+    for (;;) {
+        uint32_t assigned;
+        while ((assigned = atomic_load(&worker->assigned)) == 0) {
+            generator_futex_wait(&worker->assigned, 0);
+        }
+        if (assigned == 2) {
+            break;
+        }
 
+        generator_run(worker, worker->gen);
+        worker->gen = NULL;
+        atomic_store(&worker->assigned, 0);
+
+        // Go back to the pool, or exit if it already holds enough idle threads
+        pthread_mutex_lock(&generator_thread_pool.mtx);
+        bool keep = generator_thread_pool.idle_count < generator_thread_pool.max_idle;
+        if (keep) {
+            worker->next = generator_thread_pool.idle;
+            generator_thread_pool.idle = worker;
+            generator_thread_pool.idle_count++;
+        }
+        pthread_mutex_unlock(&generator_thread_pool.mtx);
+        if (!keep) {
+            break;
+        }
+    }
+
+    free(worker);
     return NULL;
 }
 
-// --- Public API ---
+// Binds a pool thread to gen, starting a new one if none is idle
+static bool generator_bind(generator_t* gen) {
+    pthread_mutex_lock(&generator_thread_pool.mtx);
+    generator_worker_t* worker = generator_thread_pool.idle;
+    if (worker) {
+        generator_thread_pool.idle = worker->next;
+        generator_thread_pool.idle_count--;
+    }
+    size_t stack_size = generator_thread_pool.stack_size;
+    pthread_mutex_unlock(&generator_thread_pool.mtx);
 
-/**
- * @brief Creates a new generator running the user function in a separate thread.
- *
- * @param func User-provided generator function.
- * @param user_data Data to be passed to the generator via self->user_data.
- * @return Pointer to the new generator object, or NULL on failure.
- */
-static generator_t* generator_create(generator_func_t func, void* user_data) {
+    atomic_fetch_add(&gen->refs, 1); // Released by the worker when it is done
+    gen->bound = true;
+
+    if (worker) {
+        worker->gen = gen;
+        atomic_store(&worker->assigned, 1);
+        generator_futex_wake(&worker->assigned);
+        return true;
+    }
+
+    worker = (generator_worker_t*)malloc(sizeof(generator_worker_t));
+    if (!worker) {
+        perror("malloc for generator worker failed");
+    } else {
+        worker->gen = gen;
+        atomic_init(&worker->assigned, 1);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (stack_size > 0 && pthread_attr_setstacksize(&attr, stack_size) != 0) {
+            fprintf(stderr, "Warning: generator thread stack size %zu rejected, "
+                            "using the default.\n", stack_size);
+        }
+        int rc = pthread_create(&worker->thread, &attr, generator_worker_main, worker);
+        pthread_attr_destroy(&attr);
+        if (rc == 0) {
+            return true;
+        }
+        errno = rc; // pthread_create sets errno on failure
+        perror("pthread_create failed");
+        free(worker);
+    }
+
+    atomic_fetch_sub(&gen->refs, 1);
+    gen->bound = false;
+    return false;
+}
+
+// Makes sure gen has a thread before the first handoff to it
+static inline bool generator_start(generator_t* gen) {
+    if (gen->bound) {
+        return true;
+    }
+    if (!generator_bind(gen)) {
+        gen->state = GEN_FINISHED;
+        atomic_store(&gen->ring_closed, true);
+        return false;
+    }
+    return true;
+}
+
+// Called from generator_next in run-ahead mode. Returns true with *value set,
+// or false if the ring is empty and either the generator has finished or
+// wait is false.
+static bool generator_ring_pop(generator_t* gen, int64_t* value, bool wait, bool* finished) {
+    *finished = false;
+    if (!gen->ring_started) {
+        // First pull: let the producer thread start running ahead
+        if (!generator_start(gen)) {
+            *finished = true;
+            return false;
+        }
+        gen->state = GEN_RUNNING;
+        generator_handoff(gen, GEN_TURN_GENERATOR);
+        gen->ring_started = true;
+    }
+
+    size_t head = atomic_load_explicit(&gen->ring_head, memory_order_relaxed);
+
+    if (head == atomic_load_explicit(&gen->ring_tail, memory_order_acquire)) {
+        if (!wait) {
+            return false;
+        }
+        generator_ring_park(gen, &gen->consumer_waiting, generator_ring_has_data, head);
+        if (head == atomic_load(&gen->ring_tail)) {
+            *finished = true; // Closed and drained
+            return false;
+        }
+    }
+
+    *value = gen->ring[head & gen->ring_mask];
+    atomic_store(&gen->ring_head, head + 1);
+    generator_ring_unpark(&gen->producer_waiting);
+    return true;
+}
+
+static generator_t* generator_create_internal(generator_func_t func, void* user_data,
+                                              size_t ring_capacity) {
     if (!func) {
         fprintf(stderr, "Error: Generator function cannot be NULL.\n");
         return NULL;
@@ -111,57 +464,132 @@ static generator_t* generator_create(generator_func_t func, void* user_data) {
         return NULL;
     }
 
+    gen->bound = false;         // No thread until the first next()
+    atomic_init(&gen->refs, 1);
+    atomic_init(&gen->exited, 0);
     gen->user_func = func;
     gen->user_data = user_data;
     gen->state = GEN_SUSPENDED; // Start suspended, waiting for first next()
+    atomic_init(&gen->closing, GEN_CLOSE_NONE);
     gen->yielded_value = 0;
-    gen->value_ready = false;
-    gen->started = false;       // Thread not yet started execution logic
-
-    // Initialize mutex and condition variables
-    if (pthread_mutex_init(&gen->mtx, NULL) != 0) {
-        perror("pthread_mutex_init failed");
-        free(gen);
-        return NULL;
-    }
-    if (pthread_cond_init(&gen->cond_yield, NULL) != 0) {
-        perror("pthread_cond_init (yield) failed");
-        pthread_mutex_destroy(&gen->mtx);
-        free(gen);
-        return NULL;
-    }
-    if (pthread_cond_init(&gen->cond_next, NULL) != 0) {
-        perror("pthread_cond_init (next) failed");
-        pthread_cond_destroy(&gen->cond_yield);
-        pthread_mutex_destroy(&gen->mtx);
-        free(gen);
-        return NULL;
-    }
-
-    // Create the generator thread
-    int rc = pthread_create(&gen->thread_id, NULL, generator_thread_entry, gen);
-    if (rc != 0) {
-        errno = rc; // pthread_create sets errno on failure
-        perror("pthread_create failed");
-        pthread_cond_destroy(&gen->cond_next);
-        pthread_cond_destroy(&gen->cond_yield);
-        pthread_mutex_destroy(&gen->mtx);
-        free(gen);
-        return NULL;
+    gen->sent_value = 0;
+    gen->ref_ptr = NULL;
+    gen->ref_len = 0;
+    atomic_init(&gen->turn, GEN_TURN_CALLER); // Thread waits for the first next()
+    gen->spin_budget = generator_default_spin_budget();
+    gen->batch_buf = NULL;
+    gen->batch_cap = 0;
+    gen->batch_count = 0;
+    gen->consumer = NULL;
+    gen->consumer_ctx = NULL;
+
+    gen->ring = NULL;
+    gen->ring_mask = 0;
+    atomic_init(&gen->ring_head, 0);
+    atomic_init(&gen->ring_tail, 0);
+    atomic_init(&gen->consumer_waiting, 0);
+    atomic_init(&gen->producer_waiting, 0);
+    atomic_init(&gen->ring_closed, false);
+    atomic_init(&gen->ring_stop, false);
+    gen->ring_started = false;
+    if (ring_capacity > 0) {
+        size_t capacity = 1;
+        while (capacity < ring_capacity) {
+            capacity <<= 1;
+        }
+        gen->ring = (int64_t*)malloc(capacity * sizeof(int64_t));
+        if (!gen->ring) {
+            perror("malloc for generator ring failed");
+            free(gen);
+            return NULL;
+        }
+        gen->ring_mask = capacity - 1;
     }
 
-    // printf("[Main] Created generator %p, thread %p\n", (void*)gen, (void*)gen->thread_id);
+    // printf("[Main] Created generator %p\n", (void*)gen);
     return gen;
 }
+
+// --- Public API ---
+
 /**
- * @brief Gets the next value from the generator. Signals the generator thread
- *        to run and waits for it to yield or finish.
+ * @brief Creates a new generator running the user function in a separate thread.
+ *        The thread is taken from a pool (or started) on the first
+ *        generator_next, so creating a generator does not create a thread.
+ *
+ * @param func User-provided generator function.
+ * @param user_data Data to be passed to the generator via self->user_data.
+ * @return Pointer to the new generator object, or NULL on failure.
+ */
+static generator_t* generator_create(generator_func_t func, void* user_data) {
+    return generator_create_internal(func, user_data, 0);
+}
+
+/**
+ * @brief Creates a run-ahead generator. After the first generator_next the
+ *        generator thread keeps producing into a lock-free ring of
+ *        ring_capacity values and only blocks when the ring is full, so
+ *        producer and consumer run in parallel. generator_next only blocks
+ *        when the ring is empty.
+ *
+ * @param func User-provided generator function.
+ * @param user_data Data to be passed to the generator via self->user_data.
+ * @param ring_capacity Ring size in values, rounded up to a power of two.
+ * @return Pointer to the new generator object, or NULL on failure.
+ */
+static inline generator_t* generator_create_runahead(generator_func_t func, void* user_data,
+                                                     size_t ring_capacity) {
+    return generator_create_internal(func, user_data, ring_capacity > 0 ? ring_capacity : 1);
+}
+
+/**
+ * @brief Sets how many times either side of this generator spins before
+ *        parking on a futex while waiting for the other. Larger budgets trade
+ *        CPU for handoff latency when both threads are on separate cores.
+ *
+ * @param gen The generator object.
+ * @param spins Spin iterations, or GENERATOR_SPIN_FOREVER to never park.
+ */
+static inline void generator_set_spin_budget(generator_t* gen, uint32_t spins) {
+    if (gen) gen->spin_budget = spins;
+}
+
+/**
+ * @brief Configures the pool of threads that generators run on. Threads are
+ *        only limited while idle: a generator that is resumed always gets a
+ *        thread, and threads beyond max_idle exit when their generator ends.
+ *
+ * @param stack_size Stack size for threads started from now on, 0 for the
+ *        system default.
+ * @param max_idle Maximum number of idle threads kept for reuse. Surplus idle
+ *        threads exit immediately.
+ */
+static inline void generator_thread_pool_configure(size_t stack_size, size_t max_idle) {
+    pthread_mutex_lock(&generator_thread_pool.mtx);
+    generator_thread_pool.stack_size = stack_size;
+    generator_thread_pool.max_idle = max_idle;
+    while (generator_thread_pool.idle_count > max_idle) {
+        generator_worker_t* worker = generator_thread_pool.idle;
+        generator_thread_pool.idle = worker->next;
+        generator_thread_pool.idle_count--;
+        atomic_store(&worker->assigned, 2);
+        generator_futex_wake(&worker->assigned);
+    }
+    pthread_mutex_unlock(&generator_thread_pool.mtx);
+}
+/**
+ * @brief Resumes the generator with a value and gets the next value from it.
+ *        The value is returned by the yield() the generator is suspended in;
+ *        the one that starts the generator is readable as self->sent_value.
+ *        Run-ahead generators do not wait for the caller, so for them this
+ *        is the same as generator_next and the value is dropped.
  *
  * @param gen The generator object.
+ * @param sent The value to send.
  * @param done Output parameter, set to true if the generator finished.
  * @return The yielded value, or the last yielded value if done is true.
  */
-static int64_t generator_next(generator_t* gen, bool* done) {
+static inline int64_t generator_send(generator_t* gen, int64_t sent, bool* done) {
     if (!gen) {
         if (done) *done = true;
         return 0;
@@ -170,54 +598,238 @@ static int64_t generator_next(generator_t* gen, bool* done) {
     int64_t value = 0;
     bool is_finished = false;
 
-    pthread_mutex_lock(&gen->mtx);
+    if (gen->ring) {
+        if (!generator_ring_pop(gen, &value, true, &is_finished)) {
+            value = gen->yielded_value;
+        }
+        gen->yielded_value = value;
+        if (done) *done = is_finished;
+        return value;
+    }
+
     // printf("[Main] Calling next() for gen %p. Current state: %d\n", (void*)gen, gen->state);
 
     if (gen->state == GEN_FINISHED) {
         // printf("[Main] Generator %p already finished.\n", (void*)gen);
         is_finished = true;
         value = gen->yielded_value; // Return last value
+    } else if (!generator_start(gen)) {
+        is_finished = true;
     } else {
-        // Signal the generator thread to run (or start)
-        gen->state = GEN_RUNNING; // Indicate intention to run
-        gen->value_ready = false; // We need a new value
-        // printf("[Main] Signaling generator %p to run (cond_yield).\n", (void*)gen);
-        pthread_cond_signal(&gen->cond_yield);
+        // Hand the turn (and the sent value) to the generator thread
+        gen->sent_value = sent;
+        gen->state = GEN_RUNNING;
+        generator_handoff(gen, GEN_TURN_GENERATOR);
 
         // Wait until the generator yields a value or finishes
-        // printf("[Main] Waiting for generator %p (cond_next)...\n", (void*)gen);
-        while (!gen->value_ready && gen->state != GEN_FINISHED) {
-            pthread_cond_wait(&gen->cond_next, &gen->mtx);
-        }
-        // printf("[Main] Woken up for generator %p. State: %d, ValueReady: %d\n", (void*)gen, gen->state, gen->value_ready);
+        // printf("[Main] Waiting for generator %p...\n", (void*)gen);
+        generator_await(gen, GEN_TURN_CALLER);
 
+        // The acquire in generator_await makes yielded_value/state visible
+        is_finished = (gen->state == GEN_FINISHED);
+        value = gen->yielded_value;
+    }
 
-        if (gen->state == GEN_FINISHED) {
-            is_finished = true;
-            value = gen->yielded_value; // Get value potentially set before finishing
-        } else {
-            // Generator yielded normally
-            is_finished = false;
-            value = gen->yielded_value;
-            // Important: Keep state as SUSPENDED after yield wakes us
-             if (gen->state != GEN_FINISHED) { // Avoid race if it finished while we waited
-                 // State should have been set to SUSPENDED by yield() before signaling us
-                 // If not, something is wrong, but we proceed based on value_ready
-             }
+    if (done) {
+        *done = is_finished;
+    }
+    // printf("[Main] next() returning %lld, done=%s\n", value, is_finished ? "true" : "false");
+    return value;
+}
+
+/**
+ * @brief Gets the next value from the generator. Signals the generator thread
+ *        to run and waits for it to yield or finish. Same as sending 0.
+ *
+ * @param gen The generator object.
+ * @param done Output parameter, set to true if the generator finished.
+ * @return The yielded value, or the last yielded value if done is true.
+ */
+static int64_t generator_next(generator_t* gen, bool* done) {
+    return generator_send(gen, 0, done);
+}
+
+/**
+ * @brief Gets the next value from the generator as a reference. If the
+ *        generator produced it with yield_ref() (or yield_span()), the pointer
+ *        refers to the generator's own memory, possibly its thread's stack,
+ *        and nothing is copied. It stays valid until the generator is resumed
+ *        or destroyed; copy whatever must outlive that. Run-ahead generators
+ *        keep running after a yield, so they never hand out references.
+ *
+ * @param gen The generator object.
+ * @param len Output parameter, set to the length in bytes (0 if none).
+ * @param done Output parameter, set to true if the generator finished.
+ * @return The referenced memory, or NULL if the generator finished, yielded a
+ *         plain value with yield(), or is a run-ahead generator.
+ */
+static inline const void* generator_next_ref(generator_t* gen, size_t* len, bool* done) {
+    bool finished = true;
+    if (gen) {
+        gen->ref_ptr = NULL;
+        gen->ref_len = 0;
+        generator_next(gen, &finished);
+    }
+    if (done) *done = finished;
+    if (len) *len = finished ? 0 : gen->ref_len;
+    return finished ? NULL : gen->ref_ptr;
+}
+/**
+ * @brief Gets up to cap values from the generator with a single handoff.
+ *        The generator thread stores each yield() into out without locking
+ *        or signaling, and only wakes the caller once out is full or the
+ *        generator function returns.
+ *
+ * @param gen The generator object.
+ * @param out Buffer receiving the yielded values.
+ * @param cap Capacity of out, in values.
+ * @param done Output parameter, set to true if the generator finished; the
+ *        values returned by this call are still valid in that case.
+ * @return The number of values stored in out.
+ */
+static inline size_t generator_next_batch(generator_t* gen, int64_t* out, size_t cap, bool* done) {
+    if (!gen) {
+        if (done) *done = true;
+        return 0;
+    }
+
+    size_t count = 0;
+    bool is_finished = false;
+
+    if (gen->ring) {
+        // Block for the first value only, then take whatever is buffered
+        while (count < cap && !is_finished
+               && generator_ring_pop(gen, &out[count], count == 0, &is_finished)) {
+            count++;
         }
+        if (done) *done = is_finished;
+        return count;
     }
 
-    pthread_mutex_unlock(&gen->mtx);
+    if (gen->state == GEN_FINISHED) {
+        is_finished = true;
+    } else if (out && cap > 0 && !generator_start(gen)) {
+        is_finished = true;
+    } else if (out && cap > 0) {
+        // Hand the buffer to the generator thread together with the turn
+        gen->batch_buf = out;
+        gen->batch_cap = cap;
+        gen->batch_count = 0;
+        gen->sent_value = 0;
+        gen->state = GEN_RUNNING;
+        generator_handoff(gen, GEN_TURN_GENERATOR);
+        generator_await(gen, GEN_TURN_CALLER);
+
+        count = gen->batch_count;
+        gen->batch_buf = NULL;
+        is_finished = (gen->state == GEN_FINISHED);
+    }
 
     if (done) {
         *done = is_finished;
     }
-    // printf("[Main] next() returning %lld, done=%s\n", value, is_finished ? "true" : "false");
-    return value;
+    return count;
+}
+
+/**
+ * @brief Runs the generator in push mode: each yield() calls func directly on
+ *        the generator thread instead of handing the value over, so a full
+ *        scan costs one handoff in and one out. The generator function is the
+ *        same one used with generator_next. If func returns false the
+ *        generator is suspended after that value and can be resumed later.
+ *        For run-ahead generators func is called on the caller's thread.
+ *
+ * @param gen The generator object.
+ * @param func Called with every value; returns false to stop.
+ * @param ctx Passed to func.
+ * @return true if the generator has finished, false if func stopped it.
+ */
+static inline bool generator_for_each(generator_t* gen, generator_consume_func_t func, void* ctx) {
+    if (!gen) return true;
+    if (!func) return false;
+
+    if (gen->ring) {
+        int64_t value = 0;
+        bool is_finished = false;
+        while (generator_ring_pop(gen, &value, true, &is_finished)) {
+            gen->yielded_value = value;
+            if (!func(value, ctx)) return false;
+        }
+        return true;
+    }
+
+    if (gen->state == GEN_FINISHED || !generator_start(gen)) {
+        return true;
+    }
+
+    // Hand the consumer to the generator thread together with the turn
+    gen->consumer = func;
+    gen->consumer_ctx = ctx;
+    gen->sent_value = 0;
+    gen->state = GEN_RUNNING;
+    generator_handoff(gen, GEN_TURN_GENERATOR);
+    generator_await(gen, GEN_TURN_CALLER);
+    gen->consumer = NULL;
+
+    return gen->state == GEN_FINISHED;
+}
+
+/**
+ * @brief Called from within the generator function to check whether it was
+ *        resumed by generator_close(). If so it should release what it holds
+ *        and return instead of yielding again.
+ *
+ * @param self The generator object (passed to the user function).
+ * @return true while the generator is being closed.
+ */
+static inline bool generator_is_closing(generator_t* self) {
+    return self && atomic_load(&self->closing) != GEN_CLOSE_NONE;
 }
+
 /**
- * @brief Destroys the generator, waits for its thread to finish, and cleans up resources.
- *        Ensure the generator has finished (or is signaled to finish) before calling.
+ * @brief Finishes a generator early, letting it clean up first. The yield()
+ *        it is suspended in returns 0 with generator_is_closing(self) true
+ *        (for run-ahead generators, the next yield(), whose value is
+ *        dropped), and its thread then runs the generator function until it
+ *        returns, so it can release buffers, descriptors and the like. A
+ *        generator that yields again while closing is abandoned at that
+ *        yield, as by generator_destroy. A generator that never started is
+ *        only marked finished. The generator must still be destroyed.
+ *
+ * @param gen The generator object.
+ */
+static inline void generator_close(generator_t* gen) {
+    if (!gen || gen->state == GEN_FINISHED) return;
+
+    if (!gen->bound) {
+        gen->state = GEN_FINISHED; // Never started: nothing to clean up
+        atomic_store(&gen->ring_closed, true);
+        gen->ring_started = true; // Run-ahead: do not start it on a later pull
+        return;
+    }
+
+    atomic_store(&gen->closing, GEN_CLOSE_REQUESTED);
+    if (gen->ring) {
+        // Wake a producer waiting for space and drain until it returns
+        generator_ring_unpark(&gen->producer_waiting);
+        int64_t value = 0;
+        bool is_finished = false;
+        while (generator_ring_pop(gen, &value, true, &is_finished)) {
+        }
+        return;
+    }
+
+    // Resume it out of its yield() and wait until the function has returned
+    gen->sent_value = 0;
+    gen->state = GEN_RUNNING;
+    generator_handoff(gen, GEN_TURN_GENERATOR);
+    generator_await(gen, GEN_TURN_CALLER);
+}
+
+/**
+ * @brief Destroys the generator and cleans up resources. If it is suspended in
+ *        yield(), its thread abandons the user function (without running
+ *        the rest of it) and returns to the pool before this returns.
  *
  * @param gen The generator object to destroy.
  */
@@ -226,32 +838,28 @@ static void generator_destroy(generator_t* gen) {
 
     // printf("[Main] Destroying generator %p...\n", (void*)gen);
 
-    pthread_mutex_lock(&gen->mtx);
-    bool needs_join = gen->started && gen->state != GEN_FINISHED;
-    gen->state = GEN_FINISHED; // Mark as finished
-    gen->value_ready = true;   // Ensure any waiting next() call wakes up
-    pthread_mutex_unlock(&gen->mtx); // Unlock before signaling/joining
-
-    if (needs_join) {
-        // printf("[Main] Generator %p needs join. Signaling cond_yield/cond_next...\n", (void*)gen);
-        // Signal potentially waiting threads (in yield or initial wait)
-        pthread_cond_signal(&gen->cond_yield);
-        // Signal potentially waiting next() call
-        pthread_cond_signal(&gen->cond_next);
-
-        // printf("[Main] Joining thread %p...\n", (void*)gen->thread_id);
-        pthread_join(gen->thread_id, NULL);
-        // printf("[Main] Thread %p joined.\n", (void*)gen->thread_id);
-    } else {
-         // printf("[Main] Generator %p thread already finished or not started.\n", (void*)gen);
+    if (gen->bound) {
+        atomic_store(&gen->ring_stop, true); // Run-ahead: stop a producer running ahead
+        generator_ring_unpark(&gen->producer_waiting);
+
+        gen->state = GEN_FINISHED; // Mark as finished
+        // Wake the thread if it waits in yield(); it unwinds back to the pool
+        generator_handoff(gen, GEN_TURN_GENERATOR);
+
+        // Wait until the thread has left the user function, so nothing of
+        // the generator runs after destroy returns
+        // printf("[Main] Waiting for generator %p to leave its thread...\n", (void*)gen);
+        uint32_t exited = 0;
+        while (atomic_load(&gen->exited) != 1) {
+            if (atomic_compare_exchange_weak(&gen->exited, &exited, 2) || exited == 2) {
+                generator_futex_wait(&gen->exited, 2);
+            }
+            exited = 0;
+        }
     }
 
-
-    // Clean up resources
-    pthread_mutex_destroy(&gen->mtx);
-    pthread_cond_destroy(&gen->cond_yield);
-    pthread_cond_destroy(&gen->cond_next);
-    free(gen);
+    // Clean up resources (the worker may still hold a reference briefly)
+    generator_release(gen);
     // printf("[Main] Generator %p destroyed.\n", (void*)gen);
 }
 
@@ -261,40 +869,83 @@ static void generator_destroy(generator_t* gen) {
  *
  * @param self The generator object (passed to the user function).
  * @param value The value to yield.
+ * @return The value passed to the generator_send() that resumed the
+ *         generator (0 for generator_next, and in run-ahead, batch or push
+ *         mode, where yield() does not wait for a resume).
  */
-static void yield(generator_t* self, int64_t value) {
-    if (!self) return;
+static int64_t yield(generator_t* self, int64_t value) {
+    if (!self) return 0;
+
+    if (self->ring) {
+        generator_ring_push(self, value);
+        return 0;
+    }
+
+    if (atomic_load_explicit(&self->closing, memory_order_relaxed)) {
+        generator_unwind(); // Yielded again instead of returning from close
+    }
+
+    // In batch and push mode the caller is blocked until we hand back the
+    // turn, so the buffer can be filled (or the consumer called) without
+    // synchronization; the handoff publishes the results.
+    if (self->consumer) {
+        if (self->consumer(value, self->consumer_ctx)) {
+            return 0;
+        }
+    } else if (self->batch_buf) {
+        self->batch_buf[self->batch_count++] = value;
+        if (self->batch_count < self->batch_cap) {
+            return 0;
+        }
+    }
 
-    pthread_mutex_lock(&self->mtx);
     // printf("[Thread %p] Yielding value %lld.\n", (void*)pthread_self(), value);
 
     self->yielded_value = value;
-    self->value_ready = true;
-    self->state = GEN_SUSPENDED; // Mark as suspended *before* signaling
+    self->state = GEN_SUSPENDED; // Mark as suspended *before* the handoff
 
-    // Signal the caller waiting in next() that a value is ready
-    // printf("[Thread %p] Signaling caller (cond_next).\n", (void*)pthread_self());
-    pthread_cond_signal(&self->cond_next);
+    // Hand the value to the caller waiting in next()
+    generator_handoff(self, GEN_TURN_CALLER);
 
-    // Wait for the caller to call next() again
-    // printf("[Thread %p] Waiting for caller signal (cond_yield)...\n", (void*)pthread_self());
-    while (self->state == GEN_SUSPENDED) { // Loop protects against spurious wakeups
-        pthread_cond_wait(&self->cond_yield, &self->mtx);
-         // Check if destroy was called while waiting
-         if (self->state == GEN_FINISHED) break;
-    }
+    // Wait for the caller to call next() again (or destroy us)
+    // printf("[Thread %p] Waiting for caller...\n", (void*)pthread_self());
+    generator_await(self, GEN_TURN_GENERATOR);
     // printf("[Thread %p] Woken up by caller. New state: %d\n", (void*)pthread_self(), self->state);
 
     // If state is now FINISHED (e.g., destroy called), don't proceed further
     bool finished = (self->state == GEN_FINISHED);
 
-    pthread_mutex_unlock(&self->mtx);
-
-    // If finished, exit the thread's context cleanly
+    // If finished, abandon the generator and return the thread to the pool
     if (finished) {
-        // printf("[Thread %p] Exiting due to FINISHED state after yield wait.\n", (void*)pthread_self());
-        pthread_exit(NULL);
+        // printf("[Thread %p] Unwinding due to FINISHED state after yield wait.\n", (void*)pthread_self());
+        generator_unwind();
     }
+    return self->sent_value;
 }
 
+/**
+ * @brief Called from within the generator function to yield a reference to
+ *        len bytes at ptr without copying them. The consumer reads them
+ *        through generator_next_ref(); generator_next() sees len as the value.
+ *        ptr may point into the generator thread's stack: the memory only has
+ *        to stay valid and unchanged until the generator is resumed.
+ *
+ * @param self The generator object (passed to the user function).
+ * @param ptr Memory to hand out.
+ * @param len Length of the memory in bytes.
+ * @return As for yield().
+ */
+static inline int64_t yield_ref(generator_t* self, const void* ptr, size_t len) {
+    if (self && !self->ring) {
+        self->ref_ptr = ptr;
+        self->ref_len = len;
+    }
+    return yield(self, (int64_t)len);
+}
+
+// Yields n elements of array by reference; the consumer gets the length in
+// bytes from generator_next_ref
+#define yield_span(self, array, n) \
+    yield_ref((self), (array), (size_t)(n) * sizeof(*(array)))
+
 #endif // GENERATOR_PTHREAD_H
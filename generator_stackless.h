@@ -0,0 +1,133 @@
+#ifndef GENERATOR_STACKLESS_H
+#define GENERATOR_STACKLESS_H
+
+#include <stdbool.h>
+#include <stdint.h> // For int64_t
+#include <stdio.h>
+
+// A stackless (protothread-style) generator. The generator function is an
+// ordinary function that is re-entered on every stackless_generator_next;
+// a switch on the saved resume point jumps back to just after the last
+// STACKLESS_YIELD. There is no stack to allocate and no registers to save,
+// so a resume is a plain indirect call.
+//
+// Rules for generator functions:
+//  - Wrap the body in STACKLESS_BEGIN(self) ... STACKLESS_END(self).
+//  - Local variables do NOT survive a STACKLESS_YIELD. Keep everything that
+//    must live across yields in an explicit state struct reached through
+//    self->user_data (or in statics).
+//  - STACKLESS_YIELD may only appear in the generator function itself, not
+//    in functions it calls, so recursion cannot yield. Use generator.h for
+//    recursive generators such as tree walks.
+//  - Do not put STACKLESS_YIELD inside a switch statement of your own (its
+//    case label would belong to that switch), and use at most one
+//    STACKLESS_YIELD per source line (resume points are line numbers).
+//  - Loops, if/else, early `return` (finishes the generator) and calls to
+//    functions that do not yield are all fine.
+//
+// Example:
+//
+//   typedef struct { int64_t a, b; } fib_state_t;
+//
+//   void fib(stackless_generator_t* self) {
+//       fib_state_t* st = self->user_data;
+//       STACKLESS_BEGIN(self);
+//       for (;;) {
+//           STACKLESS_YIELD(self, st->a);
+//           int64_t next_b = st->a + st->b; // Fine: not live across the yield
+//           st->a = st->b;
+//           st->b = next_b;
+//       }
+//       STACKLESS_END(self);
+//   }
+
+// --- Generator Type ---
+
+typedef struct stackless_generator stackless_generator_t;
+
+// The generator function is called once per resume
+typedef void (*stackless_generator_func_t)(stackless_generator_t* self);
+
+typedef enum { STACKLESS_RUNNING,
+    STACKLESS_SUSPENDED,
+    STACKLESS_FINISHED } stackless_state_t;
+
+struct stackless_generator {
+    int resume_point; // Line of the last yield, 0 before the first resume
+    stackless_state_t state; // State of the generator
+    stackless_generator_func_t user_func; // User-provided function
+    int64_t yielded_value; // The currently yielded value
+    void* user_data; // Explicit state that survives yields
+};
+
+// --- Generator Body Macros ---
+
+#define STACKLESS_BEGIN(self)          \
+    switch ((self)->resume_point) { \
+    case 0:
+
+#define STACKLESS_YIELD(self, value)              \
+    do {                                          \
+        (self)->yielded_value = (value);          \
+        (self)->resume_point = __LINE__;          \
+        (self)->state = STACKLESS_SUSPENDED;      \
+        return;                                   \
+    case __LINE__:;                               \
+    } while (0)
+
+#define STACKLESS_END(self) \
+    }                       \
+    (self)->state = STACKLESS_FINISHED
+
+// --- Public API Implementation ---
+
+/**
+ * @brief Initializes a stackless generator in caller-provided storage.
+ *        Nothing is allocated, so there is nothing to destroy.
+ *
+ * @param gen Storage for the generator.
+ * @param func The user-provided generator function.
+ * @param user_data State struct for everything that must survive a yield.
+ */
+static inline void stackless_generator_init(stackless_generator_t* gen,
+    stackless_generator_func_t func, void* user_data)
+{
+    gen->resume_point = 0;
+    gen->state = func ? STACKLESS_SUSPENDED : STACKLESS_FINISHED;
+    gen->user_func = func;
+    gen->yielded_value = 0;
+    gen->user_data = user_data;
+}
+
+/**
+ * @brief Gets the next value from the generator by calling its function,
+ * which continues after its last STACKLESS_YIELD.
+ *
+ * @param gen Pointer to the generator to operate on.
+ * @param done Output parameter. Set to true if the generator has finished.
+ * @return The yielded value if the generator is not finished, otherwise the
+ * last yielded value (rely on the done flag).
+ */
+static inline int64_t stackless_generator_next(stackless_generator_t* gen,
+    bool* done)
+{
+    if (!gen || gen->state == STACKLESS_FINISHED) {
+        if (done)
+            *done = true;
+        return gen ? gen->yielded_value : 0;
+    }
+
+    gen->state = STACKLESS_RUNNING;
+    gen->user_func(gen);
+    if (gen->state == STACKLESS_RUNNING) {
+        // Returned without yielding: a plain `return` or the end of the body
+        gen->state = STACKLESS_FINISHED;
+    }
+
+    if (done) {
+        *done = (gen->state == STACKLESS_FINISHED);
+    }
+    return gen->yielded_value;
+}
+
+#endif // GENERATOR_STACKLESS_H
@@ -0,0 +1,122 @@
+#ifndef GENERATOR_TYPED_H
+#define GENERATOR_TYPED_H
+
+#if !defined(GENERATOR_H) && !defined(GENERATOR_PTHREAD_H)
+#error "Include generator.h or generator_pthread.h before generator_typed.h"
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // For memset
+
+// Typed generators on top of either backend. GENERATOR_DEFINE(name, T)
+// generates:
+//
+//   name_t        Generator handle; the generator function gets a name_t*
+//                 and reads its argument from self->user_data as usual.
+//   name_func_t   void (*)(name_t* self)
+//   name_create   name_t* name_create(func, user_data, stack_size)
+//                 (stack_size is ignored by generator_pthread.h)
+//   name_next     T name_next(name_t* gen, bool* done)
+//   name_yield    void name_yield(name_t* self, T value)
+//   name_destroy  void name_destroy(name_t* gen)
+//
+// The yielded value is stored inline in the handle, so structs of any size
+// are passed without boxing or per-item allocation: one copy in name_yield,
+// one in name_next. Values do not go through the int64_t paths, so typed
+// generators are used with name_next only (not with batch, run-ahead or push
+// mode).
+//
+// Example:
+//
+//   typedef struct { int32_t key; double value; } entry_t;
+//   GENERATOR_DEFINE(entry_gen, entry_t)
+//
+//   void entries(entry_gen_t* self) {
+//       for (int32_t i = 0; i < 3; ++i) {
+//           entry_gen_yield(self, (entry_t) { i, i * 0.5 });
+//       }
+//   }
+//
+//   entry_gen_t* gen = entry_gen_create(entries, NULL, 0);
+//   bool done = false;
+//   for (entry_t e = entry_gen_next(gen, &done); !done; e = entry_gen_next(gen, &done)) { ... }
+//   entry_gen_destroy(gen);
+
+#ifdef GENERATOR_PTHREAD_H
+#define GENERATOR_TYPED_CREATE(func, user_data, stack_size) \
+    ((void)(stack_size), generator_create((func), (user_data)))
+#else
+#define GENERATOR_TYPED_CREATE(func, user_data, stack_size) \
+    generator_create((func), (user_data), (stack_size))
+#endif
+
+#define GENERATOR_DEFINE(name, T)                                                \
+    typedef struct name name##_t;                                                \
+    typedef void (*name##_func_t)(name##_t * self);                              \
+                                                                                 \
+    struct name {                                                                \
+        generator_t* gen; /* Underlying generator */                             \
+        name##_func_t user_func; /* User-provided function */                    \
+        void* user_data; /* Data passed during creation */                       \
+        T value; /* Last yielded value, stored inline */                         \
+    };                                                                           \
+                                                                                 \
+    static inline void name##_entry(generator_t* gen)                            \
+    {                                                                            \
+        name##_t* self = (name##_t*)gen->user_data;                              \
+        self->user_func(self);                                                   \
+    }                                                                            \
+                                                                                 \
+    static inline name##_t* name##_create(name##_func_t func, void* user_data,   \
+        size_t stack_size)                                                       \
+    {                                                                            \
+        if (!func) {                                                             \
+            fprintf(stderr, "Error: Generator function cannot be NULL.\n");      \
+            return NULL;                                                         \
+        }                                                                        \
+        name##_t* self = (name##_t*)malloc(sizeof(name##_t));                    \
+        if (!self) {                                                             \
+            perror("malloc for " #name "_t failed");                             \
+            return NULL;                                                         \
+        }                                                                        \
+        self->user_func = func;                                                  \
+        self->user_data = user_data;                                             \
+        memset(&self->value, 0, sizeof(T));                                      \
+        self->gen = GENERATOR_TYPED_CREATE(name##_entry, self, stack_size);      \
+        if (!self->gen) {                                                        \
+            free(self);                                                          \
+            return NULL;                                                         \
+        }                                                                        \
+        return self;                                                             \
+    }                                                                            \
+                                                                                 \
+    static inline T name##_next(name##_t* self, bool* done)                      \
+    {                                                                            \
+        if (!self) {                                                             \
+            T none;                                                              \
+            memset(&none, 0, sizeof(T));                                         \
+            if (done)                                                            \
+                *done = true;                                                    \
+            return none;                                                         \
+        }                                                                        \
+        generator_next(self->gen, done);                                         \
+        return self->value;                                                      \
+    }                                                                            \
+                                                                                 \
+    static inline void name##_yield(name##_t* self, T value)                     \
+    {                                                                            \
+        self->value = value;                                                     \
+        yield(self->gen, 0);                                                     \
+    }                                                                            \
+                                                                                 \
+    static inline void name##_destroy(name##_t* self)                            \
+    {                                                                            \
+        if (self) {                                                              \
+            generator_destroy(self->gen);                                        \
+            free(self);                                                          \
+        }                                                                        \
+    }
+
+#endif // GENERATOR_TYPED_H
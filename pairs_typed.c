@@ -0,0 +1,73 @@
+#ifdef USE_PTHREAD
+#include "generator_pthread.h"
+#else
+#include "generator.h"
+#endif
+#include "generator_typed.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Yields (key, value) pairs by value: each entry_t is stored inline in the
+// generator handle, so nothing is boxed or allocated per item. Build with
+// -DUSE_PTHREAD to run the same generator on generator_pthread.h.
+
+typedef struct {
+    int32_t key;
+    double value;
+} entry_t;
+
+GENERATOR_DEFINE(entry_gen, entry_t)
+
+typedef struct {
+    const char* text; // "key=value" pairs separated by spaces
+} parse_state_t;
+
+// Parses pairs one at a time and yields each as soon as it is complete
+void parse_entries(entry_gen_t* self)
+{
+    parse_state_t* st = self->user_data;
+    const char* p = st->text;
+    while (*p) {
+        char* end = NULL;
+        long key = strtol(p, &end, 10);
+        if (end == p || *end != '=') {
+            return; // Malformed input ends the stream
+        }
+        p = end + 1;
+        double value = strtod(p, &end);
+        if (end == p) {
+            return;
+        }
+        p = end;
+        while (*p == ' ') {
+            ++p;
+        }
+        entry_gen_yield(self, (entry_t) { (int32_t)key, value });
+    }
+}
+
+int32_t main()
+{
+    parse_state_t state = { "1=0.5 2=1.25 3=2.0 5=3.75 8=6.5" };
+    entry_gen_t* gen = entry_gen_create(parse_entries, &state, 0);
+    if (!gen) {
+        return EXIT_FAILURE;
+    }
+
+    printf("Entries:\n");
+    bool done = false;
+    int32_t count = 0;
+    double total = 0;
+    for (entry_t e = entry_gen_next(gen, &done); !done; e = entry_gen_next(gen, &done)) {
+        printf("key %" PRId32 " -> %.2f\n", e.key, e.value);
+        total += e.value;
+        ++count;
+    }
+    printf("%" PRId32 " entries, total %.2f\n", count, total);
+
+    entry_gen_destroy(gen);
+    return (count == 5) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
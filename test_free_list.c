@@ -0,0 +1,68 @@
+#include "generator.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// With GENERATOR_FREE_LIST, generator_create reuses a destroyed generator of
+// the same function, control block and stack included, when its stack is
+// large enough. Build with -DGENERATOR_FREE_LIST (and optionally
+// -DGENERATOR_ASM_SWITCH -DGENERATOR_COMPACT).
+
+#ifndef GENERATOR_FREE_LIST
+#error "Build test_free_list.c with -DGENERATOR_FREE_LIST"
+#endif
+
+void count_func(generator_t* self)
+{
+    for (int64_t i = 0;; ++i) {
+        yield(self, i);
+    }
+}
+
+void other_func(generator_t* self)
+{
+    yield(self, -1);
+}
+
+// Creates, runs and destroys a generator of func with stack_size, and
+// reports whether the second create got the first one back
+static bool reused(generator_func_t func, size_t stack_size)
+{
+    bool done = false;
+    generator_t* first = generator_create(func, NULL, stack_size);
+    assert(first);
+    generator_next(first, &done);
+    generator_destroy(first);
+
+    generator_t* second = generator_create(func, NULL, stack_size);
+    assert(second);
+    int64_t value = generator_next(second, &done);
+    assert(!done && (value == 0 || value == -1)); // Restarted from the top
+    generator_destroy(second);
+    return second == first;
+}
+
+int32_t main()
+{
+    assert(reused(count_func, 0)); // Default size
+    assert(reused(count_func, 64 * 1024));
+    assert(reused(other_func, 16 * 1024));
+
+#ifndef GENERATOR_SHARED_STACK
+    // A larger request than the parked stack gets a new generator
+    bool done = false;
+    generator_t* small = generator_create(count_func, NULL, 16 * 1024);
+    generator_next(small, &done);
+    generator_destroy(small);
+    generator_t* large = generator_create(count_func, NULL, 4 * 1024 * 1024);
+    assert(large && large != small);
+    generator_destroy(large);
+#endif
+
+    generator_free_list_flush();
+    printf("All free list tests passed.\n");
+    return EXIT_SUCCESS;
+}
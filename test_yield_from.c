@@ -0,0 +1,134 @@
+#include "generator.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// yield_from on generators wrapped by combinators: the delegate's own stages
+// apply to its values before those of the delegating generator, and a take
+// limit on the delegate ends only the delegation.
+
+static int32_t cleanups;
+
+// 0, 1, 2, ... until closed
+void count_func(generator_t* self)
+{
+    for (int64_t i = 0; !generator_is_closing(self); ++i) {
+        yield(self, i);
+    }
+    ++cleanups;
+}
+
+// Yields 100, everything of the generator in user_data, then 200
+void outer_func(generator_t* self)
+{
+    yield(self, 100);
+    yield_from(self, self->user_data);
+    yield(self, 200);
+}
+
+int64_t times_ten(int64_t value, void* ctx)
+{
+    (void)ctx;
+    return value * 10;
+}
+
+int64_t plus_one(int64_t value, void* ctx)
+{
+    (void)ctx;
+    return value + 1;
+}
+
+bool is_odd(int64_t value, void* ctx)
+{
+    (void)ctx;
+    return value % 2 != 0;
+}
+
+typedef struct {
+    int64_t values[16];
+    size_t count;
+} collected_t;
+
+bool collect(int64_t value, void* ctx)
+{
+    collected_t* c = ctx;
+    c->values[c->count++] = value;
+    return c->count < 16;
+}
+
+// Drains gen with generator_next and checks it produced expected[0..n)
+static void expect(generator_t* gen, const int64_t* expected, size_t n)
+{
+    bool done = false;
+    size_t i = 0;
+    for (int64_t value = generator_next(gen, &done); !done; value = generator_next(gen, &done)) {
+        printf("%" PRId64 " ", value);
+        assert(i < n && value == expected[i]);
+        ++i;
+    }
+    printf("\n");
+    assert(i == n);
+}
+
+int32_t main()
+{
+    // take on the delegate: 0, 1, 2 and then the outer generator carries on
+    generator_t* sub = generator_take(generator_create(count_func, NULL, 0), 3);
+    generator_t* outer = generator_create(outer_func, sub, 0);
+    assert(sub && outer);
+    expect(outer, (const int64_t[]) { 100, 0, 1, 2, 200 }, 5);
+    generator_close(sub); // Still suspended at its take limit
+    assert(cleanups == 1);
+    generator_destroy(outer);
+    generator_destroy(sub);
+
+    // Stages of the delegate first (odd values, times ten, first two), then
+    // those of the outer generator (plus one, first four)
+    sub = generator_take(generator_map(generator_filter(
+                             generator_create(count_func, NULL, 0), is_odd, NULL),
+                             times_ten, NULL),
+        2);
+    outer = generator_take(generator_map(generator_create(outer_func, sub, 0),
+                               plus_one, NULL),
+        4);
+    assert(sub && outer);
+    expect(outer, (const int64_t[]) { 101, 11, 31, 201 }, 4);
+    generator_close(outer);
+    generator_close(sub);
+    assert(cleanups == 2);
+    generator_destroy(outer);
+    generator_destroy(sub);
+
+    // The same chain in push and batch mode
+    sub = generator_take(generator_map(generator_create(count_func, NULL, 0),
+                             times_ten, NULL),
+        3);
+    outer = generator_create(outer_func, sub, 0);
+    collected_t pushed = { { 0 }, 0 };
+    assert(generator_for_each(outer, collect, &pushed));
+    assert(pushed.count == 5 && pushed.values[1] == 0 && pushed.values[3] == 20
+        && pushed.values[4] == 200);
+    generator_destroy(outer);
+    generator_close(sub);
+    generator_destroy(sub);
+
+    sub = generator_take(generator_create(count_func, NULL, 0), 4);
+    outer = generator_create(outer_func, sub, 0);
+    int64_t batch[8];
+    bool done = false;
+    size_t n = generator_next_batch(outer, batch, 3, &done);
+    assert(n == 3 && !done && batch[0] == 100 && batch[2] == 1);
+    n = generator_next_batch(outer, batch, 8, &done);
+    assert(n == 3 && done && batch[0] == 2 && batch[1] == 3 && batch[2] == 200);
+    generator_destroy(outer);
+    generator_close(sub);
+    generator_destroy(sub);
+    assert(cleanups == 4);
+
+    printf("All yield_from tests passed.\n");
+    return EXIT_SUCCESS;
+}